@@ -0,0 +1,272 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "curses_ui.h"
+#include "curses_ui_internal.h"
+#include "curses_ui_reorder.h"
+
+/*
+ * Microbenchmarks for the ui hot paths, run headless (see ui_init_headless()).
+ *
+ * Every benchmark is timed over BENCH_RUNS runs and the fastest run is kept, which filters out most
+ * scheduling noise.  Raw results are in nanoseconds per operation, but what gets compared is the cost
+ * relative to a calibration loop timed in the same run, so a slower or faster host moves both alike.
+ * The baselines file holds "name relative_cost" lines; the run fails when any benchmark is more than
+ * the allowed percentage slower than its baseline.  Regenerate the baselines with -u after a deliberate
+ * change to a hot path.
+ */
+
+#define BENCH_RUNS 7
+#define BENCH_EXTRA_CMDS 1000		// on top of the built-in commands, within CURSES_UI_MAX_POSSIBLE_COMMANDS
+#define BENCH_MAX_NAME 32
+
+typedef struct bench {
+    const char *name;
+    unsigned int iterations;		// per run
+    void (*op)(unsigned int i);
+    double ns;				// fastest run, per operation
+    double cost;			// ns relative to the calibration loop
+    double baseline;			// 0 if the baselines file has no entry
+} bench_t;
+
+static char cmd_names[BENCH_EXTRA_CMDS][BENCH_MAX_NAME];
+static char message[128];
+static volatile unsigned int calibration_sink;
+
+
+// Plain formatting and hashing, the kind of work the ui hot paths do, without touching the ui
+static void op_calibrate(unsigned int i)
+{
+    char line[256];
+    int len = snprintf(line, sizeof(line), "[%02u:%02u:%02u] %s: %s", i % 24, i % 60, i % 60, "peer", message);
+    unsigned int h = 2166136261u;
+    for (int j = 0; j < len; j++)
+        h = (h ^ (unsigned char)line[j]) * 16777619u;
+    calibration_sink = h;
+}
+
+
+static int bench_cmd_function(ui_state_t *state, char *str)
+{
+    return 0;
+}
+
+
+static void op_run_cmd(unsigned int i)
+{
+    static char cmd[] = "\\bench0999 argument";
+    run_cmd(cmd);
+}
+
+
+static void op_chat_win_print(unsigned int i)
+{
+    chat_win_print("peer", message);
+}
+
+
+static void op_status_line_set(unsigned int i)
+{
+    status_line_set("Connected to %s as %s (%u)", "#mchat", "bench", i);
+}
+
+
+static void op_status_line_urg_set(unsigned int i)
+{
+    status_line_urg_set(1, "Reordering %s: hold %ums, %u held", "on", 50, i);
+}
+
+
+static void op_recv_plain(unsigned int i)
+{
+    ui_recv_message("peer", message);
+}
+
+
+static void op_recv_stamped(unsigned int i)
+{
+    char stamped[sizeof(message) + CURSES_UI_REORDER_STAMP_MAX];
+    reorder_stamp_t stamp = { i, 1792354999000000LL + i };
+    int len = reorder_format_stamp(stamped, &stamp);
+    snprintf(stamped + len, sizeof(stamped) - len, "%s", message);
+    ui_recv_message("stamper", stamped);
+}
+
+
+static bench_t calibration = { "calibration", 50000, op_calibrate };
+
+static bench_t benches[] = {
+    { "run_cmd", 20000, op_run_cmd },
+    { "chat_win_print", 20000, op_chat_win_print },
+    { "status_line_set", 50000, op_status_line_set },
+    { "status_line_urg_set", 50000, op_status_line_urg_set },
+    { "recv_plain", 20000, op_recv_plain },
+    { "recv_stamped", 20000, op_recv_stamped },
+};
+#define BENCH_COUNT (sizeof(benches) / sizeof(benches[0]))
+
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static void bench_run(bench_t *b)
+{
+    // One untimed pass to warm caches and let buffers reach their working size
+    for (unsigned int i = 0; i < b->iterations / 10; i++)
+        b->op(i);
+    b->ns = -1;
+    for (int run = 0; run < BENCH_RUNS; run++)
+    {
+        double start = now_ns();
+        for (unsigned int i = 0; i < b->iterations; i++)
+            b->op(i);
+        double ns = (now_ns() - start) / b->iterations;
+        if (b->ns < 0 || ns < b->ns)
+            b->ns = ns;
+    }
+}
+
+
+static int baselines_load(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    char line[256], name[BENCH_MAX_NAME];
+    double cost;
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (line[0] == '#' || sscanf(line, "%31s %lf", name, &cost) != 2)
+            continue;
+        for (unsigned int i = 0; i < BENCH_COUNT; i++)
+        {
+            if (strcmp(benches[i].name, name) == 0)
+                benches[i].baseline = cost;
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+
+static int baselines_save(const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    if (!fp)
+        return -1;
+    fprintf(fp, "# curses_ui_bench baselines: cost per operation relative to the calibration loop, fastest of %d runs\n",
+        BENCH_RUNS);
+    fprintf(fp, "# Regenerate with: curses_ui_bench -u -b <this file>\n");
+    for (unsigned int i = 0; i < BENCH_COUNT; i++)
+        fprintf(fp, "%s %.3f\n", benches[i].name, benches[i].cost);
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-b BASELINES] [-t MAX_SLOWDOWN_PERCENT] [-u]\n", prog);
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *baselines = NULL;
+    double max_slowdown = 50;
+    int update = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:t:uh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            baselines = optarg;
+            break;
+        case 't':
+            if ((max_slowdown = atof(optarg)) <= 0)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'u':
+            update = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (update && !baselines)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (baselines && !update && baselines_load(baselines) != 0)
+    {
+        fprintf(stderr, "curses_ui_bench: could not read %s\n", baselines);
+        return 1;
+    }
+
+    if (ui_init_headless("bench") != 0)
+    {
+        fprintf(stderr, "curses_ui_bench: could not set up a headless screen\n");
+        return 1;
+    }
+    // A nearly full command table, with the command being dispatched at the end of it
+    for (unsigned int i = 0; i < BENCH_EXTRA_CMDS; i++)
+    {
+        snprintf(cmd_names[i], BENCH_MAX_NAME, "bench%04u", i);
+        add_cmd(cmd_names[i], cmd_names[i], "benchmark command", bench_cmd_function);
+    }
+    memset(message, 0, sizeof(message));
+    for (unsigned int i = 0; i < 100; i++)
+        message[i] = 'a' + i % 26;
+
+    bench_run(&calibration);
+    for (unsigned int i = 0; i < BENCH_COUNT; i++)
+    {
+        bench_run(&benches[i]);
+        benches[i].cost = benches[i].ns / calibration.ns;
+    }
+    ui_destroy();
+
+    int failed = 0;
+    printf("%-22s %12s %9s %9s %9s\n", "benchmark", "ns/op", "cost", "baseline", "change");
+    printf("%-22s %12.1f %9.3f %9s %9s\n", calibration.name, calibration.ns, 1.0, "-", "-");
+    for (unsigned int i = 0; i < BENCH_COUNT; i++)
+    {
+        bench_t *b = &benches[i];
+        if (update || b->baseline <= 0)
+        {
+            printf("%-22s %12.1f %9.3f %9s %9s\n", b->name, b->ns, b->cost, "-", "-");
+            continue;
+        }
+        double change = (b->cost / b->baseline - 1) * 100;
+        int slower = change > max_slowdown;
+        failed |= slower;
+        printf("%-22s %12.1f %9.3f %9.3f %+8.1f%%%s\n", b->name, b->ns, b->cost, b->baseline, change,
+            slower ? "  SLOWER" : "");
+    }
+
+    if (update)
+    {
+        if (baselines_save(baselines) != 0)
+        {
+            fprintf(stderr, "curses_ui_bench: could not write %s\n", baselines);
+            return 1;
+        }
+        printf("Baselines written to %s\n", baselines);
+    }
+    else if (failed)
+        printf("FAILED: slower than the baseline by more than %.0f%%\n", max_slowdown);
+    return failed;
+}
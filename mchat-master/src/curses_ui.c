@@ -5,6 +5,8 @@
 #include <unistd.h>
 #include <ncurses.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
 #include <time.h>
 #include "curses_ui.h"
 #include "curses_ui_internal.h"
@@ -16,32 +18,170 @@
 #define chat_win_y(y) y - 9
 #define input_win_y(y) 8
 
+// Upper bound on replayed messages delivered per timer tick at max speed
+#define CURSES_UI_REPLAY_BATCH 1024
+
+// Upper bound on network messages received per main loop iteration
+#define CURSES_UI_RECV_BATCH 256
+
+// Longest the main loop waits for input before polling mchat for messages again
+#define CURSES_UI_MAX_WAIT_MS 100
+
+#define CURSES_UI_CAPTURE_FLUSH_MS 1000
+
+// Number of color pairs handed out to peer nicknames
+#define CURSES_UI_PEER_COLORS 6
+
 // Global UI State - See curses_ui_interal.h for details
 static ui_state_t state;
 
+// Split cw_print_fmt around the nickname and message conversions so the timestamp can be cached and
+// nicknames and message bodies can be drawn with their own attributes
+static void chat_win_split_fmt()
+{
+    free(state.cw_print_head);
+    free(state.cw_print_mid);
+    state.cw_print_head = NULL;
+    state.cw_print_mid = NULL;
+    state.cw_print_tail = NULL;
+    state.cw_time_last = -1;
+
+    char *nick = NULL, *msg = NULL;
+    for (char *p = strstr(state.cw_print_fmt, "%s"); p; p = strstr(p + 2, "%s"))
+    {
+        nick = msg;
+        msg = p;
+    }
+    if (!nick)
+        return;
+    state.cw_print_head = strndup(state.cw_print_fmt, nick - state.cw_print_fmt);
+    state.cw_print_mid = strndup(nick + 2, msg - nick - 2);
+    state.cw_print_tail = msg + 2;
+}
+
+
+// Pick a color for a peer once and keep it on its interned entry
+static attr_t chat_win_peer_attr(nick_entry_t *peer)
+{
+    if (!peer->attr_valid)
+    {
+        if (has_colors() && COLOR_PAIRS > CURSES_UI_PEER_COLORS)
+            peer->attr = COLOR_PAIR(1 + peer->hash % CURSES_UI_PEER_COLORS);
+        else
+            peer->attr = A_BOLD;
+        peer->attr_valid = 1;
+    }
+    return (attr_t)peer->attr;
+}
+
+
+// Move to the line after the last one written - messages may wrap or carry newlines
+static void chat_win_next_line()
+{
+    unsigned int y = getcury(state.chat_win);
+    if (y < chat_win_y(state.max_line) - 2)
+        state.cw_line = y + 1;
+    else
+    {
+        scroll(state.chat_win);
+        state.cw_line = chat_win_y(state.max_line) - 2;
+    }
+}
+
+
 void chat_win_print(char *nickname, char *message)
 {
+    chat_win_print_hl(nickname, message, NULL, 0);
+}
+
+
+void chat_win_print_hl(char *nickname, char *message, highlight_match_t *hl, unsigned int hl_count)
+{
+    nick_entry_t *peer = nick_intern(state.nicks, nickname);
+    if (peer && state.cw_print_head)
+    {
+        chat_win_print_peer(peer, message, hl, hl_count);
+        return;
+    }
+
     time_t t = time(0);
     struct tm *ts = localtime(&t);
     mvwprintw(state.chat_win, state.cw_line, 2, state.cw_print_fmt, ts->tm_hour, ts->tm_min, ts->tm_sec,
         ts->tm_year + 1900, ts->tm_mon + 1, ts->tm_mday, nickname, message);
-    if (state.cw_line < chat_win_y(state.max_line) - 2)
-        state.cw_line++;
-    else
-        scroll(state.chat_win);
+    chat_win_next_line();
+}
+
+
+void chat_win_print_peer(nick_entry_t *peer, char *message, highlight_match_t *hl, unsigned int hl_count)
+{
+    if (!state.cw_print_head)
+    {
+        chat_win_print(peer->name, message);
+        return;
+    }
+
+    // The timestamp only needs formatting once per second
+    time_t t = time(0);
+    if (t != state.cw_time_last)
+    {
+        struct tm *ts = localtime(&t);
+        snprintf(state.cw_time_buf, sizeof(state.cw_time_buf), state.cw_print_head, ts->tm_hour, ts->tm_min,
+            ts->tm_sec, ts->tm_year + 1900, ts->tm_mon + 1, ts->tm_mday);
+        state.cw_time_last = t;
+    }
+
+    mvwaddstr(state.chat_win, state.cw_line, 2, state.cw_time_buf);
+    attr_t attr = chat_win_peer_attr(peer);
+    wattron(state.chat_win, attr);
+    waddnstr(state.chat_win, peer->name, peer->len);
+    wattroff(state.chat_win, attr);
+    wprintw(state.chat_win, state.cw_print_mid);
+
+    unsigned int pos = 0;
+    for (unsigned int i = 0; i < hl_count; i++)
+    {
+        waddnstr(state.chat_win, message + pos, hl[i].start - pos);
+        wattron(state.chat_win, A_BOLD | A_REVERSE);
+        waddnstr(state.chat_win, message + hl[i].start, hl[i].len);
+        wattroff(state.chat_win, A_BOLD | A_REVERSE);
+        pos = hl[i].start + hl[i].len;
+    }
+    waddstr(state.chat_win, message + pos);
+    wprintw(state.chat_win, state.cw_print_tail);
+    chat_win_next_line();
+}
+
+// Format into *buf, growing it as needed up to CURSES_UI_MAX_STATUS_SIZE (longer text is truncated)
+static void status_format(char **buf, unsigned int *cap, const char *fmt, va_list args)
+{
+    va_list retry;
+    va_copy(retry, args);
+    int len = vsnprintf(*buf, *cap, fmt, args);
+    if (len >= 0 && (unsigned int)len >= *cap)
+    {
+        unsigned int want = len + 1 < CURSES_UI_STATUS_INITIAL_SIZE ? CURSES_UI_STATUS_INITIAL_SIZE : len + 1;
+        if (want > CURSES_UI_MAX_STATUS_SIZE)
+            want = CURSES_UI_MAX_STATUS_SIZE;
+        char *grown = want > *cap ? realloc(*buf, want) : NULL;
+        if (grown)
+        {
+            *buf = grown;
+            *cap = want;
+        }
+        if (*buf)
+            vsnprintf(*buf, *cap, fmt, retry);
+    }
+    va_end(retry);
 }
 
+
 void status_line_set(char *str, ...)
 {
     if (str)
     {
-        int len = strlen(str);
-            if (len >= 1024)
-            return;
-
         va_list args;
         va_start(args, str);
-        vsprintf(state.status_line_buf, str, args);
+        status_format(&state.status_line_buf, &state.status_line_cap, str, args);
         va_end(args);
     }
     if (!state.status_line_is_urg)
@@ -49,25 +189,25 @@ void status_line_set(char *str, ...)
         wattroff(state.status_win, A_BOLD);
         for (unsigned int i = 0; i < state.max_col; i++)
             mvwaddch(state.status_win, 0, i, ' ');
-        mvwprintw(state.status_win, 0, 1, "Status: %s", state.status_line_buf);
+        mvwprintw(state.status_win, 0, 1, "Status: %s", state.status_line_buf ? state.status_line_buf : "");
+        if (state.hl_count)
+            wprintw(state.status_win, " | Highlights: %u", state.hl_count);
     }
 }
 
 
 void status_line_urg_set(int now, char *str, ...)
 {
-    if (strlen(str) > 1024)
-        return;
     va_list args;
     va_start(args, str);
-    vsprintf(state.status_line_urg_buf, str, args);
+    status_format(&state.status_line_urg_buf, &state.status_line_urg_cap, str, args);
     va_end(args);
     if (now)
     {
         wattron(state.status_win, A_BOLD);
         for (unsigned int i = 0; i < state.max_col; i++)
             mvwaddch(state.status_win, 0, i, ' ');
-        mvwprintw(state.status_win, 0, 1, "Status: %s", state.status_line_urg_buf);
+        mvwprintw(state.status_win, 0, 1, "Status: %s", state.status_line_urg_buf ? state.status_line_urg_buf : "");
         state.status_line_is_urg = 1;
     }
 }
@@ -79,11 +219,48 @@ void status_line_urg_unset()
     for (unsigned int i = 0; i < state.max_col; i++)
         mvwaddch(state.status_win, 0, i, ' ');
 
-    mvwprintw(state.status_win, 0, 1, "Status: %s", state.status_line_buf);
+    mvwprintw(state.status_win, 0, 1, "Status: %s", state.status_line_buf ? state.status_line_buf : "");
     state.status_line_is_urg = 0;
 }
 
 
+// Make o the active modal overlay, replacing any overlay already on screen
+void overlay_open(ui_overlay_t *o)
+{
+    if (state.overlay_blocked)
+    {
+        if (o->free)
+            o->free(&state, o);
+        delwin(o->win);
+        free(o);
+        state.overlay_refused = 1;
+        return;
+    }
+    if (state.overlay)
+        overlay_close();
+    keypad(o->win, TRUE);
+    state.overlay = o;
+}
+
+
+void overlay_close()
+{
+    ui_overlay_t *o = state.overlay;
+    if (!o)
+        return;
+    state.overlay = NULL;
+    if (o->free)
+        o->free(&state, o);
+    delwin(o->win);
+    free(o);
+    werase(stdscr);
+    wnoutrefresh(stdscr);
+    touchwin(state.chat_win);
+    touchwin(state.input_win);
+    touchwin(state.status_win);
+}
+
+
 int is_cmd(char *cmdstr)
 {
     // This could be more sophisticated in the future
@@ -103,24 +280,499 @@ int run_cmd(char *cmdstr)
 
     for (unsigned int i = 0; i < state.cmd_count; i++)
     {
-        if (strncasecmp(state.cmd_names[i], ptr, strlen(state.cmd_names[i])) == 0)
+        if (strncasecmp(state.cmds[i].name, ptr, state.cmds[i].name_len) == 0)
             found = i;
     }
 
     if (found  == -1)
         return -4096;
     else
-        return state.cmd_funcs[found](&state, ptr);
+        return state.cmds[found].func(&state, ptr);
+}
+
+// Returns the text after keyword, blanks skipped, if str starts with it as a whole word, otherwise NULL
+char *match_keyword(char *str, const char *keyword)
+{
+    size_t len = strlen(keyword);
+    if (strncasecmp(str, keyword, len) != 0 || (str[len] != '\0' && !isspace((unsigned char)str[len])))
+        return NULL;
+    str += len;
+    while (isspace((unsigned char)str[0])) str++;
+    return str;
 }
 
 // Add new command to the UI - Should be used by init routine to plugins in the future
 void add_cmd(const char *cmdstr, const char *syntax, const char *help, cmd_function func)
 {
-    state.cmd_names[state.cmd_count] = cmdstr;
-    state.cmd_syntax[state.cmd_count] = syntax;
-    state.cmd_help[state.cmd_count] = help;
-    state.cmd_funcs[state.cmd_count] = func;
-    state.cmd_count++;
+    if (state.cmd_count == state.cmd_cap)
+    {
+        unsigned int cap = state.cmd_cap ? state.cmd_cap * 2 : 16;
+        ui_cmd_t *cmds = realloc(state.cmds, cap * sizeof(ui_cmd_t));
+        if (!cmds)
+            return;
+        state.cmds = cmds;
+        state.cmd_cap = cap;
+    }
+    ui_cmd_t *cmd = &state.cmds[state.cmd_count++];
+    cmd->name = cmdstr;
+    cmd->name_len = strlen(cmdstr);
+    cmd->func = func;
+    cmd->syntax = syntax;
+    cmd->help = help;
+}
+
+
+static long long now_usec(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+// Schedule func on the main loop after delay_ms, repeating every period_ms if non-zero
+ui_timer_t *runnable_add(unsigned int delay_ms, unsigned int period_ms, runnable func, void *arg)
+{
+    return timer_add(state.runnables, delay_ms, period_ms, func, arg);
+}
+
+
+void runnable_cancel(ui_timer_t *t)
+{
+    timer_cancel(state.runnables, t);
+}
+
+
+// Common receive path for network, daemon and replayed messages
+static void ui_recv_deliver(nick_entry_t *peer, const char *body)
+{
+    highlight_match_t hl[CURSES_UI_MAX_HIGHLIGHTS];
+    unsigned int hl_count = highlighter_scan(state.highlighter, body, hl, CURSES_UI_MAX_HIGHLIGHTS);
+    if (hl_count)
+        state.hl_count++;
+    chat_win_print_peer(peer, (char *)body, hl, hl_count);
+}
+
+
+static void capture_message(nick_entry_t *peer, char *body, long long recv_usec)
+{
+    // libmchat does not expose the sender address per message, so the channel is the source
+    char channel[MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE];
+    channel[0] = '\0';
+    if (state.mchat)
+        mchatv1_get_channel(state.mchat, channel, MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE);
+    if (capture_write(state.capture, recv_usec, peer->id, peer->name, channel, body) != 0)
+    {
+        capture_close(&state.capture);
+        status_line_urg_set(1, "Capture stopped: write failed");
+    }
+}
+
+
+// Reassemble fragments and pass complete messages on to be displayed
+static void ui_recv_reassemble(nick_entry_t *peer, const char *body)
+{
+    frag_header_t hdr;
+    const char *payload = frag_parse(body, &hdr);
+    if (!payload)
+    {
+        ui_recv_deliver(peer, body);
+        return;
+    }
+    char *message = frag_add(state.frags, peer->id, &hdr, payload, now_usec(CLOCK_MONOTONIC) / 1000);
+    if (message)
+    {
+        ui_recv_deliver(peer, message);
+        free(message);
+    }
+}
+
+
+// Messages leave the reordering buffer here in sequence order
+static void reorder_deliver(void *arg, unsigned int sender, const char *body)
+{
+    nick_entry_t *peer = nick_lookup_id(state.nicks, sender);
+    if (peer)
+        ui_recv_reassemble(peer, body);
+}
+
+
+static int reorder_runnable(ui_state_t *s, void *arg)
+{
+    int next = reorder_expire(state.reorder, now_usec(CLOCK_MONOTONIC) / 1000);
+    state.reorder_timer = next < 0 ? NULL : runnable_add(next, 0, reorder_runnable, NULL);
+    return 1;
+}
+
+
+// Update the sender's statistics, put stamped messages back in sender order, then reassemble and display them
+static void ui_recv_process(nick_entry_t *peer, char *body, long long recv_usec)
+{
+    reorder_stamp_t stamp;
+    const char *rest = reorder_parse(body, &stamp);
+    peer_stats_update(&peer->stats, recv_usec, rest ? stamp.sent_usec : -1);
+    if (!rest)
+    {
+        ui_recv_reassemble(peer, body);
+        return;
+    }
+    if (!state.reorder_enabled)
+    {
+        ui_recv_reassemble(peer, rest);
+        return;
+    }
+    reorder_add(state.reorder, peer->id, &stamp, rest, now_usec(CLOCK_MONOTONIC) / 1000);
+    if (reorder_held(state.reorder) && !state.reorder_timer)
+        state.reorder_timer = runnable_add(reorder_hold_ms(state.reorder), 0, reorder_runnable, NULL);
+}
+
+
+// Release everything held for reordering and stop or start holding messages
+void ui_reorder_enable(int enable)
+{
+    reorder_flush(state.reorder);
+    if (state.reorder_timer)
+    {
+        runnable_cancel(state.reorder_timer);
+        state.reorder_timer = NULL;
+    }
+    state.reorder_enabled = enable;
+}
+
+
+// A message arrived from the network or the shared daemon
+void ui_recv_message(char *nick, char *body)
+{
+    nick_entry_t *peer = nick_intern(state.nicks, nick);
+    if (!peer)
+    {
+        // Out of memory for a new nickname - show the text without any per-peer state, and without the
+        // stamp and fragment header it may carry
+        reorder_stamp_t stamp;
+        frag_header_t hdr;
+        const char *text = reorder_parse(body, &stamp);
+        if (!text)
+            text = body;
+        const char *payload = frag_parse(text, &hdr);
+        chat_win_print(nick, (char *)(payload ? payload : text));
+        return;
+    }
+    long long recv_usec = now_usec(CLOCK_REALTIME);
+    if (state.capture)
+        capture_message(peer, body, recv_usec);
+    ui_recv_process(peer, body, recv_usec);
+}
+
+
+// The nickname table is full and drops the peer it has not seen for longest, so forget its id everywhere
+static void nick_evicted(void *arg, nick_entry_t *peer)
+{
+    reorder_forget(state.reorder, peer->id);
+    frag_forget(state.frags, peer->id);
+    if (state.capture)
+        capture_forget_nick(state.capture, peer->id);
+}
+
+
+static int frag_expire_runnable(ui_state_t *s, void *arg)
+{
+    frag_expire(state.frags, now_usec(CLOCK_MONOTONIC) / 1000);
+    return 0;
+}
+
+
+static void daemon_detach(const char *why)
+{
+    sock_conn_destroy(&state.daemon);
+    state.daemon_peers_pending = 0;
+    status_line_set("Disconnected");
+    status_line_urg_set(1, "%s", why);
+}
+
+
+// Read whatever the shared daemon has sent and act on every complete frame
+static void daemon_poll()
+{
+    if (sock_conn_read(state.daemon) < 0)
+    {
+        daemon_detach("Lost connection to the shared daemon");
+        return;
+    }
+
+    char *fields[CURSES_UI_SOCK_MAX_FIELDS];
+    int count;
+    while ((count = sock_conn_next_frame(state.daemon, fields, CURSES_UI_SOCK_MAX_FIELDS)) > 0)
+    {
+        if (strcmp(fields[0], "MSG") == 0 && count >= 3)
+            ui_recv_message(fields[1], fields[2]);
+        else if (strcmp(fields[0], "NICK") == 0 && count >= 2)
+            ui_set_nickname(fields[1]);
+        else if (strcmp(fields[0], "STATUS") == 0 && count >= 2)
+            status_line_set("%s as %s", fields[1], state.daemon_nick);
+        else if (strcmp(fields[0], "PEER") == 0 && count >= 5)
+        {
+            if (state.daemon_peers_next_count == state.daemon_peers_next_cap)
+            {
+                unsigned int cap = state.daemon_peers_next_cap ? state.daemon_peers_next_cap * 2 : 16;
+                peer_row_t *rows = realloc(state.daemon_peers_next, cap * sizeof(peer_row_t));
+                if (!rows)
+                    continue;
+                state.daemon_peers_next = rows;
+                state.daemon_peers_next_cap = cap;
+            }
+            peer_row_t *row = &state.daemon_peers_next[state.daemon_peers_next_count++];
+            snprintf(row->nick, sizeof(row->nick), "%s", fields[1]);
+            snprintf(row->chan, sizeof(row->chan), "%s", fields[2]);
+            snprintf(row->ip, sizeof(row->ip), "%s", fields[3]);
+            row->last_seen = atol(fields[4]);
+        }
+        else if (strcmp(fields[0], "ERR") == 0 && count >= 2)
+            status_line_urg_set(1, "Shared daemon: %s", fields[1]);
+        else if (strcmp(fields[0], "PEERS_END") == 0)
+        {
+            // Swap the finished snapshot in and reuse the old one for the next request
+            peer_row_t *rows = state.daemon_peers;
+            unsigned int cap = state.daemon_peers_cap;
+            state.daemon_peers = state.daemon_peers_next;
+            state.daemon_peers_cap = state.daemon_peers_next_cap;
+            state.daemon_peer_count = state.daemon_peers_next_count;
+            state.daemon_peers_next = rows;
+            state.daemon_peers_next_cap = cap;
+            state.daemon_peers_next_count = 0;
+            state.daemon_peers_serial++;
+            if (state.daemon_peers_pending)
+                state.daemon_peers_pending--;
+        }
+    }
+}
+
+
+// Send one mchat message, stamped (when enabled) so receivers can put our messages back in order
+static int ui_send_raw(char *body)
+{
+    char stamped[MCHAT_LIMIT_MAX_MESSAGE_SIZE];
+    int stamp_len = 0;
+    if (state.stamp_outgoing)
+    {
+        reorder_stamp_t stamp;
+        stamp.seq = state.send_seq++;
+        stamp.sent_usec = now_usec(CLOCK_REALTIME);
+        stamp_len = reorder_format_stamp(stamped, &stamp);
+    }
+    snprintf(stamped + stamp_len, sizeof(stamped) - stamp_len, "%s", body);
+
+    if (state.mchat)
+        return mchatv1_send_message(state.mchat, stamped);
+    if (state.daemon)
+        return sock_conn_queue(state.daemon, "SEND", stamped, NULL);
+    return -1;
+}
+
+
+// Send a message, splitting it into fragments if it does not fit in one mchat message
+int ui_send_message(char *body)
+{
+    size_t len = strlen(body);
+    if (len < MCHAT_LIMIT_MAX_MESSAGE_SIZE - CURSES_UI_REORDER_STAMP_MAX && body[0] != CURSES_UI_FRAG_MARK)
+        return ui_send_raw(body);
+
+    frag_header_t hdr;
+    hdr.seq = state.frag_seq++;
+    hdr.count = (len + CURSES_UI_FRAG_PAYLOAD - 1) / CURSES_UI_FRAG_PAYLOAD;
+    if (hdr.count > CURSES_UI_FRAG_MAX_COUNT)
+        return -1;
+    char fragment[MCHAT_LIMIT_MAX_MESSAGE_SIZE];
+    for (hdr.index = 0; hdr.index < hdr.count; hdr.index++)
+    {
+        size_t offset = hdr.index * CURSES_UI_FRAG_PAYLOAD;
+        size_t chunk = len - offset < CURSES_UI_FRAG_PAYLOAD ? len - offset : CURSES_UI_FRAG_PAYLOAD;
+        int header_len = frag_format_header(fragment, &hdr);
+        memcpy(fragment + header_len, body + offset, chunk);
+        fragment[header_len + chunk] = '\0';
+        if (ui_send_raw(fragment) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+
+void ui_get_nickname(char *buf, size_t len)
+{
+    if (state.mchat)
+        mchatv1_get_nickname(state.mchat, buf, len);
+    else
+        snprintf(buf, len, "%s", state.daemon_nick);
+}
+
+
+void ui_set_nickname(char *nick)
+{
+    if (state.mchat)
+        mchatv1_set_nickname(state.mchat, nick, strlen(nick));
+    else
+        snprintf(state.daemon_nick, sizeof(state.daemon_nick), "%s", nick);
+    highlighter_set_nick(state.highlighter, nick);
+}
+
+
+// Snapshot of the peer list.  When attached to a daemon this is the last list it sent, and a fresh
+// one is requested at most once a second.
+unsigned int ui_get_peers(peer_row_t **rows)
+{
+    if (state.mchat)
+        return peer_rows_from_mchat(state.mchat, rows);
+
+    *rows = NULL;
+    if (!state.daemon)
+        return 0;
+    long long now_ms = now_usec(CLOCK_MONOTONIC) / 1000;
+    if (now_ms - state.daemon_peers_requested >= 1000)
+        ui_request_peers();
+    if (state.daemon_peer_count == 0)
+        return 0;
+    *rows = malloc(state.daemon_peer_count * sizeof(peer_row_t));
+    if (!*rows)
+        return 0;
+    memcpy(*rows, state.daemon_peers, state.daemon_peer_count * sizeof(peer_row_t));
+    return state.daemon_peer_count;
+}
+
+
+// Ask the shared daemon for a fresh peer list.  Returns the value daemon_peers_serial will have once
+// the answer is in, or 0 when there is no daemon to ask.
+unsigned long ui_request_peers()
+{
+    if (!state.daemon)
+        return 0;
+    sock_conn_queue(state.daemon, "PEERS", NULL);
+    state.daemon_peers_requested = now_usec(CLOCK_MONOTONIC) / 1000;
+    return state.daemon_peers_serial + ++state.daemon_peers_pending;
+}
+
+
+// Refresh the channel directory from one peer list snapshot
+void ui_scan_channels()
+{
+    peer_row_t *rows;
+    unsigned int count = ui_get_peers(&rows);
+    long long now_ms = now_usec(CLOCK_MONOTONIC) / 1000;
+    channel_dir_begin_scan(state.channels);
+    for (unsigned int i = 0; i < count; i++)
+        channel_dir_add_peer(state.channels, rows[i].chan, rows[i].last_seen, now_ms);
+    channel_dir_end_scan(state.channels, now_ms);
+    free(rows);
+}
+
+
+static void replay_stop()
+{
+    runnable_cancel(state.replay_timer);
+    state.replay_timer = NULL;
+    capture_close(&state.replay);
+    free(state.replay_next);
+    state.replay_next = NULL;
+}
+
+
+// Milliseconds until the next replayed record is due
+static unsigned int replay_delay()
+{
+    if (state.replay_speed <= 0)
+        return 0;
+    long long elapsed = now_usec(CLOCK_MONOTONIC) - state.replay_wall_base;
+    long long due = (state.replay_next->usec - state.replay_rec_base) / state.replay_speed;
+    return due > elapsed ? (due - elapsed + 999) / 1000 : 0;
+}
+
+
+// Deliver every replayed record that is due according to the replay speed, then re-arm for the next one
+static int replay_runnable(ui_state_t *s, void *arg)
+{
+    state.replay_timer = NULL;
+    for (int i = 0; state.replay && (state.replay_speed > 0 || i < CURSES_UI_REPLAY_BATCH); i++)
+    {
+        capture_record_t *rec = state.replay_next;
+        if (replay_delay() > 0)
+            break;
+        nick_entry_t *peer = nick_intern(state.nicks, rec->nick);
+        if (peer)
+            ui_recv_process(peer, rec->body, rec->usec);
+        state.replay_count++;
+
+        int ret = capture_read(state.replay, rec);
+        if (ret <= 0)
+        {
+            replay_stop();
+            if (ret < 0)
+                status_line_urg_set(1, "Replay stopped: capture file is corrupt (%lu messages)", state.replay_count);
+            else
+                status_line_urg_set(1, "Replay finished (%lu messages)", state.replay_count);
+        }
+    }
+    if (state.replay)
+        state.replay_timer = runnable_add(replay_delay(), 0, replay_runnable, NULL);
+    return 0;
+}
+
+
+static int capture_flush_runnable(ui_state_t *s, void *arg)
+{
+    if (!state.capture)
+    {
+        state.capture_timer = NULL;
+        return 1;
+    }
+    capture_flush(state.capture);
+    return 0;
+}
+
+
+// Record every received message to path until ui_destroy()
+int ui_capture_start(const char *path)
+{
+    capture_close(&state.capture);
+    state.capture = capture_open_write(path);
+    if (!state.capture)
+    {
+        status_line_urg_set(1, "Could not open capture file %s", path);
+        return -1;
+    }
+    if (!state.capture_timer)
+        state.capture_timer = runnable_add(CURSES_UI_CAPTURE_FLUSH_MS, CURSES_UI_CAPTURE_FLUSH_MS, capture_flush_runnable, NULL);
+    return 0;
+}
+
+
+// Feed a capture file back through the receive path at speed times real time (0 for max speed)
+int ui_replay_start(const char *path, double speed)
+{
+    replay_stop();
+    state.replay_count = 0;
+    state.replay_speed = speed < 0 ? 0 : speed;
+    state.replay = capture_open_read(path);
+    state.replay_next = malloc(sizeof(capture_record_t));
+    if (!state.replay || !state.replay_next || capture_read(state.replay, state.replay_next) != 1)
+    {
+        replay_stop();
+        status_line_urg_set(1, "Could not replay capture file %s", path);
+        return -1;
+    }
+    state.replay_rec_base = state.replay_next->usec;
+    state.replay_wall_base = now_usec(CLOCK_MONOTONIC);
+    state.replay_timer = runnable_add(0, 0, replay_runnable, NULL);
+    return 0;
+}
+
+
+// Accept scripted commands and messages on a Unix domain socket at path
+int ui_control_start(const char *path)
+{
+    if (control_start(&state, path) != 0)
+    {
+        status_line_urg_set(1, "Could not open control socket %s: %s", path, strerror(errno));
+        return -1;
+    }
+    return 0;
 }
 
 
@@ -153,15 +805,44 @@ void ui_resize()
 
 //Public functions
 
+// Set up a curses screen nobody sees, so the ui can run without a terminal
+static int ui_headless_screen()
+{
+    state.headless_out = fopen("/dev/null", "w");
+    state.headless_in = fopen("/dev/null", "r");
+    if (state.headless_out && state.headless_in)
+        state.headless_screen = newterm("vt100", state.headless_out, state.headless_in);
+    if (state.headless_screen)
+        return 0;
+    if (state.headless_out)
+        fclose(state.headless_out);
+    if (state.headless_in)
+        fclose(state.headless_in);
+    return -1;
+}
+
+
 // Most of this function is dark ncurses voodoo magic - so do not touch!
-void ui_init(char *nickname)
+static int ui_init_common(int headless)
 {
     memset(&state, 0, sizeof(ui_state_t));
+    if (headless && ui_headless_screen() != 0)
+        return -1;
 
     //set defaults
     state.cw_print_fmt = (char*)default_cw_print_fmt;
     state.iw_cmd_escape = (char)default_iw_cmd_escape;
     state.iw_prompt = (char*)default_iw_prompt;
+    chat_win_split_fmt();
+    state.highlighter = highlighter_create();
+    state.nicks = nick_table_create(CURSES_UI_MAX_NICKS, nick_evicted, NULL);
+    state.runnables = timer_wheel_create(&state, now_usec(CLOCK_MONOTONIC) / 1000);
+    state.control_fd = -1;
+    state.frags = frag_table_create();
+    runnable_add(CURSES_UI_FRAG_TIMEOUT_MS / 5, CURSES_UI_FRAG_TIMEOUT_MS / 5, frag_expire_runnable, NULL);
+    state.reorder = reorder_create(CURSES_UI_REORDER_HOLD_MS, CURSES_UI_REORDER_SIZE, reorder_deliver, NULL);
+    state.reorder_enabled = 1;
+    state.channels = channel_dir_create();
 
     // set line and column stuff
     state.iw_col_prompt = 2;
@@ -172,13 +853,25 @@ void ui_init(char *nickname)
 
     // Load built-in commands
     load_builtin_cmds(&state);
+    load_highlight_cmds(&state);
+    load_reorder_cmds(&state);
+    load_memstat_cmds(&state);
     // initialize ncurses
-    initscr();
+    if (!headless)
+        initscr();
     getmaxyx(stdscr, state.max_line, state.max_col);
     cbreak();
     noecho();
     nonl();
-    halfdelay(1);
+    if (has_colors())
+    {
+        // Peer nickname colors, see chat_win_peer_attr()
+        static const short peer_colors[CURSES_UI_PEER_COLORS] = { COLOR_RED, COLOR_GREEN, COLOR_YELLOW, COLOR_BLUE, COLOR_MAGENTA, COLOR_CYAN };
+        start_color();
+        use_default_colors();
+        for (short i = 0; i < CURSES_UI_PEER_COLORS && i + 1 < COLOR_PAIRS; i++)
+            init_pair(i + 1, peer_colors[i], -1);
+    }
     state.chat_win = newwin(chat_win_y(state.max_line), state.max_col, 0, 0);
     state.input_win = newwin(input_win_y(state.max_line), state.max_col, chat_win_y(state.max_line), 0);
     state.status_win = newwin(0, state.max_col, state.max_line - 1, 0);
@@ -195,30 +888,132 @@ void ui_init(char *nickname)
     wrefresh(state.chat_win);
     wrefresh(state.status_win);
     wrefresh(state.input_win);
+    state.running = 1;
+    return 0;
+}
+
+
+void ui_init(char *nickname)
+{
+    ui_init_common(0);
 
     // finally start mchat
     state.mchat = mchatv1_init(NULL);
+    char nick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];
+    mchatv1_get_nickname(state.mchat, nick, MCHAT_LIMIT_MAX_NICKNAME_SIZE);
+    highlighter_set_nick(state.highlighter, nick);
     status_line_set("Disconnected");
-    state.running = 1;
 }
 
+
+// Thin client mode: the mchat endpoint is owned by a shared daemon listening on path
+int ui_init_attached(char *nickname, const char *path)
+{
+    ui_init_common(0);
+
+    // Only shown until the daemon sends the nickname it bound to our login
+    if (!nickname)
+        nickname = getenv("USER");
+    ui_set_nickname(nickname && nickname[0] ? nickname : "mchat");
+
+    int fd = sock_connect_unix(path);
+    if (fd < 0 || !(state.daemon = sock_conn_create(fd)))
+    {
+        if (fd >= 0)
+            close(fd);
+        status_line_set("Disconnected");
+        status_line_urg_set(1, "Could not attach to the shared daemon at %s", path);
+        return -1;
+    }
+    sock_conn_queue(state.daemon, "HELLO", NULL);
+    status_line_set("Attaching to %s", path);
+    return 0;
+}
+
+
+// The ui without a terminal or an mchat endpoint, for benchmarks and tests: windows are drawn to
+// /dev/null and nothing is sent.  Returns -1 if curses could not set up a screen.
+int ui_init_headless(char *nickname)
+{
+    if (ui_init_common(1) != 0)
+        return -1;
+    ui_set_nickname(nickname ? nickname : "mchat");
+    status_line_set("Headless");
+    return 0;
+}
+
+
+// Make room for len bytes in the input buffer
+static int input_buf_reserve(unsigned int len)
+{
+    if (len <= state.input_buf_cap)
+        return 0;
+    unsigned int cap = state.input_buf_cap ? state.input_buf_cap : CURSES_UI_INPUT_INITIAL_SIZE;
+    while (cap < len)
+        cap *= 2;
+    if (cap > CURSES_UI_MAX_INPUT_SIZE)
+        cap = CURSES_UI_MAX_INPUT_SIZE;
+    char *buf = realloc(state.input_buf, cap);
+    if (!buf)
+        return -1;
+    state.input_buf = buf;
+    state.input_buf_cap = cap;
+    return 0;
+}
+
+
+// Give back the memory a long message needed once it has been sent
+static void input_buf_shrink()
+{
+    if (state.input_buf_cap <= CURSES_UI_INPUT_INITIAL_SIZE)
+        return;
+    char *buf = realloc(state.input_buf, CURSES_UI_INPUT_INITIAL_SIZE);
+    if (buf)
+    {
+        state.input_buf = buf;
+        state.input_buf_cap = CURSES_UI_INPUT_INITIAL_SIZE;
+    }
+}
+
+
 // Our main event loop for the UI
 void ui_run()
 {
     while (state.running)
     {
-        state.iw_next = mvwgetch(state.input_win, state.iw_line, state.iw_col);
-        if (state.iw_next != ERR)
+        // Run due runnables, then wait for input no longer than the next deadline
+        long long now_ms = now_usec(CLOCK_MONOTONIC) / 1000;
+        timer_wheel_run(state.runnables, now_ms);
+        int wait_ms = timer_wheel_next_timeout(state.runnables, now_usec(CLOCK_MONOTONIC) / 1000, CURSES_UI_MAX_WAIT_MS);
+        wtimeout(state.overlay ? state.overlay->win : state.input_win, wait_ms);
+
+        if (state.overlay)
+        {
+            // Modal overlay on screen - it gets all keystrokes until it closes
+            state.iw_next = wgetch(state.overlay->win);
+            if (state.iw_next == KEY_RESIZE)
+            {
+                overlay_close();
+                ui_resize();
+            }
+            else if (state.iw_next != ERR && state.overlay->key(&state, state.overlay, state.iw_next))
+                overlay_close();
+        }
+        else if ((state.iw_next = mvwgetch(state.input_win, state.iw_line, state.iw_col)) != ERR)
         {
             // Reset status_line
             if (state.status_line_is_urg && !state.status_line_urg_nodismiss)
                 status_line_urg_unset();
 
             // Catch message length
-            if (state.input_buf_len == MCHAT_LIMIT_MAX_MESSAGE_SIZE - 1)
+            if (state.input_buf_len == CURSES_UI_MAX_INPUT_SIZE - 1)
             {
                 status_line_urg_set(1, "Maximum Message Length");
             }
+            else if (state.iw_next >= 32 && state.iw_next <= 126 && input_buf_reserve(state.input_buf_len + 2) != 0)
+            {
+                status_line_urg_set(1, "Out of memory");
+            }
             // Printable ascii range
             else if (state.iw_next >= 32 && state.iw_next <= 126)
             {
@@ -270,9 +1065,9 @@ void ui_run()
                     }
                     else
                     {
-                        mchatv1_send_message(state.mchat, state.input_buf);
+                        ui_send_message(state.input_buf);
                         char nick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];
-                        mchatv1_get_nickname(state.mchat, nick, MCHAT_LIMIT_MAX_NICKNAME_SIZE);
+                        ui_get_nickname(nick, MCHAT_LIMIT_MAX_NICKNAME_SIZE);
                         chat_win_print(nick, state.input_buf);
                     }
                     if (state.iw_line != input_win_y(state.max_line) - 2)
@@ -283,6 +1078,7 @@ void ui_run()
                     waddch(state.input_win, ' ');
                     state.iw_col = state.iw_col_start;
                     state.input_buf_len = 0;
+                    input_buf_shrink();
                 }
             }
             //handle terminal resizes
@@ -297,8 +1093,9 @@ void ui_run()
             }
         }
 
+        // Drain what has arrived so the reordering buffer sees messages as close to arrival as possible
         mchat_message_t *mesg;
-        if (mchatv1_recv_message(state.mchat, &mesg) > 0)
+        for (unsigned int i = 0; state.mchat && i < CURSES_UI_RECV_BATCH && mchatv1_recv_message(state.mchat, &mesg) > 0; i++)
         {
             char recv_nick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];
             char recv_mesg[MCHAT_LIMIT_MAX_MESSAGE_SIZE];
@@ -307,23 +1104,67 @@ void ui_run()
             mchatv1_message_get_body(mesg, recv_mesg, MCHAT_LIMIT_MAX_MESSAGE_SIZE);
             mchatv1_message_get_nickname(mesg, recv_nick, MCHAT_LIMIT_MAX_NICKNAME_SIZE);
             mchatv1_message_destroy(&mesg);
-            chat_win_print(recv_nick, recv_mesg);
+            ui_recv_message(recv_nick, recv_mesg);
         }
+        control_service(&state);
+        if (state.daemon)
+            daemon_poll();
+        if (state.daemon && sock_conn_flush(state.daemon) != 0)
+            daemon_detach("Lost connection to the shared daemon");
 
-        refresh();
+        // Stage every window and update the terminal once so overlays do not flicker
+        wnoutrefresh(stdscr);
         box(state.chat_win, 0, 0);
         box(state.input_win, 0, 0);
-        wrefresh(state.chat_win);
+        wnoutrefresh(state.chat_win);
         status_line_set(NULL);
-        wrefresh(state.status_win);
-        wrefresh(state.input_win);
+        wnoutrefresh(state.status_win);
+        wnoutrefresh(state.input_win);
+        if (state.overlay)
+        {
+            if (state.overlay->draw)
+                state.overlay->draw(&state, state.overlay);
+            touchwin(state.overlay->win);
+            wnoutrefresh(state.overlay->win);
+        }
+        doupdate();
     }
 }
 
 // Time to die
 void ui_destroy()
 {
-    mchatv1_send_message(state.mchat, "<Diconnected>");
-    mchatv1_destroy(&state.mchat);
+    overlay_close();
+    control_stop(&state);
+    ui_send_message("<Diconnected>");
+    if (state.mchat)
+        mchatv1_destroy(&state.mchat);
+    if (state.daemon)
+    {
+        sock_conn_flush(state.daemon);
+        sock_conn_destroy(&state.daemon);
+    }
+    free(state.daemon_peers);
+    free(state.daemon_peers_next);
+    highlighter_destroy(&state.highlighter);
+    capture_close(&state.capture);
+    replay_stop();
+    reorder_destroy(&state.reorder);
+    channel_dir_destroy(&state.channels);
+    free(state.cmds);
+    free(state.input_buf);
+    free(state.status_line_buf);
+    free(state.status_line_urg_buf);
+    timer_wheel_destroy(&state.runnables);
+    free(state.cw_print_head);
+    free(state.cw_print_mid);
+    nick_table_destroy(&state.nicks);
+    frag_table_destroy(&state.frags);
     endwin();
+    if (state.headless_screen)
+    {
+        delscreen(state.headless_screen);
+        fclose(state.headless_out);
+        fclose(state.headless_in);
+    }
 }
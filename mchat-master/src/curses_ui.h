@@ -2,6 +2,12 @@
 #define CURSES_UI_H
 
 void ui_init(char *nickname);
+int ui_init_attached(char *nickname, const char *path);
+int ui_init_headless(char *nickname);
+int ui_daemon_run(const char *path);
 void ui_run();
+int ui_capture_start(const char *path);
+int ui_replay_start(const char *path, double speed);
+int ui_control_start(const char *path);
 void ui_destroy();
 #endif // CURSES_UI_H
@@ -17,6 +17,7 @@
  * -connect - connect to channel
  * -disconnect - disconnect from channel
  * -peerlist - list of peers we have seen
+ * -chanlist - list of channels discovered on the network
  *
  * built-in commands to implement
  * -loadcmd - load a new command
@@ -26,6 +27,66 @@
  */
 
 
+// Modal views are built here and handed to the main loop as overlays.  Their sub-windows are
+// kept alongside the overlay so they can be refreshed and released with it.
+#define MODAL_MAX_WINS 6
+
+typedef struct modal_view {
+    unsigned int win_count;
+    WINDOW *wins[MODAL_MAX_WINS];
+    int line;
+    int sort;			// column a sortable view is ordered by
+    unsigned long version;	// data version last drawn by views that only redraw on change
+    long drawn;			// time those views were last drawn
+    long scanned;		// time a view that refreshes its own data last did so
+    unsigned long peers_serial;	// daemon peer list that refresh was based on
+} modal_view_t;
+
+
+static int modal_any_key(ui_state_t *state, ui_overlay_t *o, int key)
+{
+    return 1;
+}
+
+
+static void modal_free(ui_state_t *state, ui_overlay_t *o)
+{
+    modal_view_t *view = o->data;
+    for (unsigned int i = 0; i < view->win_count; i++)
+        delwin(view->wins[i]);
+    free(view);
+}
+
+
+// Wrap win and its sub-windows in an overlay and put it on screen
+static int modal_open(WINDOW *win, WINDOW **subs, unsigned int count, overlay_key_function key, overlay_draw_function draw)
+{
+    modal_view_t *view = calloc(1, sizeof(modal_view_t));
+    ui_overlay_t *o = calloc(1, sizeof(ui_overlay_t));
+    if (!view || !o)
+    {
+        free(view);
+        free(o);
+        for (unsigned int i = 0; i < count; i++)
+            delwin(subs[i]);
+        delwin(win);
+        status_line_urg_set(1, "Out of memory");
+        return -1;
+    }
+    view->win_count = count;
+    for (unsigned int i = 0; i < count; i++)
+        view->wins[i] = subs[i];
+    o->win = win;
+    o->data = view;
+    o->data_size = sizeof(modal_view_t);
+    o->key = key;
+    o->draw = draw;
+    o->free = modal_free;
+    overlay_open(o);
+    return 0;
+}
+
+
 const char *help_string = "help";
 const char *help_syntax = "\\HELP [COMMAND]";
 const char *help_help = "Get help text for command";
@@ -46,7 +107,7 @@ int help_function(ui_state_t *state, char *str)
     int cmdnum = -1;
     for (int i = 0; i < state->cmd_count; i++)
     {
-        if (strncasecmp(cmd, state->cmd_names[i], strlen(state->cmd_names[i])) == 0)
+        if (strncasecmp(cmd, state->cmds[i].name, state->cmds[i].name_len) == 0)
             cmdnum = i;
     }
 
@@ -68,23 +129,16 @@ int help_function(ui_state_t *state, char *str)
 
     wattron(text_win, A_BOLD);
     char *header = "Command Help";
-    mvwprintw(text_win, 0, (x / 2) - (strlen(header) / 2) - (strlen(state->cmd_names[cmdnum]) / 2) - 1, "%s: %s", header, state->cmd_names[cmdnum]);
+    mvwprintw(text_win, 0, (x / 2) - (strlen(header) / 2) - (state->cmds[cmdnum].name_len / 2) - 1, "%s: %s", header, state->cmds[cmdnum].name);
     wattroff(text_win, A_BOLD);
 
-    mvwprintw(text_win, 3, 0, "Syntax: %s", state->cmd_syntax[cmdnum]);
-    mvwprintw(text_win, 4, 0, state->cmd_help[cmdnum]);
+    mvwprintw(text_win, 3, 0, "Syntax: %s", state->cmds[cmdnum].syntax);
+    mvwprintw(text_win, 4, 0, state->cmds[cmdnum].help);
 
     char *footer = "Press any key to continue...";
     mvwprintw(text_win, y - 1, (x / 2) - (strlen(footer) / 2), footer);
 
-    int ret = 0;
-    while((ret = wgetch(help_win)) == ERR);
-
-    delwin(text_win);
-    delwin(help_win);
-    werase(stdscr);
-    refresh();
-    return ret;
+    return modal_open(help_win, &text_win, 1, modal_any_key, NULL);
 }
 
 
@@ -122,10 +176,15 @@ int nick_function(ui_state_t *state, char *str)
     if (strlen(str) == strlen(nick_string))
     {
         char nick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];
-        mchatv1_get_nickname(state->mchat, nick, MCHAT_LIMIT_MAX_NICKNAME_SIZE);
+        ui_get_nickname(nick, MCHAT_LIMIT_MAX_NICKNAME_SIZE);
         status_line_urg_set(1, "Your nickname is %s", nick);
         return 0;
     }
+    if (state->daemon)
+    {
+        status_line_urg_set(1, "\\NICK ERROR: The shared daemon names you after your login");
+        return -1;
+    }
     char *ptr = str + strlen(nick_string);
     while (isspace(ptr[0])) ptr++;
     int newlen = strlen(ptr);
@@ -137,15 +196,17 @@ int nick_function(ui_state_t *state, char *str)
     }
 
     char oldnick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];
-    mchatv1_get_nickname(state->mchat, oldnick, MCHAT_LIMIT_MAX_NICKNAME_SIZE);
-    mchatv1_set_nickname(state->mchat, ptr, newlen);
+    ui_get_nickname(oldnick, MCHAT_LIMIT_MAX_NICKNAME_SIZE);
+    ui_set_nickname(ptr);
 
     char *msg;
     asprintf(&msg, "%s has changed their nickname to %s", oldnick, ptr);
-    mchatv1_send_message(state->mchat, msg);
+    ui_send_message(msg);
     free(msg);
     status_line_urg_set(1, "Your new nickname is %s", ptr);
-    if (mchatv1_is_connected(state->mchat))
+    if (state->daemon)
+        status_line_set("Attached to the shared daemon as %s", ptr);
+    else if (state->mchat && mchatv1_is_connected(state->mchat))
     {
         char channel[2048];
         mchatv1_get_channel(state->mchat, channel, 2048);
@@ -174,9 +235,6 @@ int list_function(ui_state_t *state, char  *str)
     touchwin(list_win);
     wborder(cmd_win, ' ', 0, ' ', ' ', ' ', ' ', ' ',' ');
     wborder(syntax_win, ' ', 0, ' ', ' ', ' ', ' ', ' ',' ');
-    wrefresh(cmd_win);
-    wrefresh(syntax_win);
-    wrefresh(help_win);
 
     // Print headings
     wattron(cmd_win, A_BOLD);
@@ -192,24 +250,17 @@ int list_function(ui_state_t *state, char  *str)
     int line = 1;
     for (int i = 0; i < state->cmd_count; i++)
     {
-        mvwprintw(cmd_win, line, 0, "\\%s", state->cmd_names[i]);
-        mvwprintw(syntax_win, line, 0, state->cmd_syntax[i]);
-        mvwprintw(help_win, line, 0, state->cmd_help[i]);
+        mvwprintw(cmd_win, line, 0, "\\%s", state->cmds[i].name);
+        mvwprintw(syntax_win, line, 0, state->cmds[i].syntax);
+        mvwprintw(help_win, line, 0, state->cmds[i].help);
         line = getcury(help_win) + 1;
     }
 
     char *footer = "Press any key to continue...";
     mvwprintw(list_win, y - 2, (x / 2) - (strlen(footer) / 2), footer);
 
-    int ret = 0;
-    while ((ret = wgetch(list_win)) == ERR);
-    delwin(cmd_win);
-    delwin(syntax_win);
-    delwin(help_win);
-    delwin(list_win);
-    werase(stdscr);
-    refresh();
-    return ret;
+    WINDOW *subs[3] = { cmd_win, syntax_win, help_win };
+    return modal_open(list_win, subs, 3, modal_any_key, NULL);
 }
 
 
@@ -218,6 +269,11 @@ const char *connect_syntax = "\\CONNECT [CHANNEL_NAME]";
 const char *connect_help = "Connect to a defined channel (defaults to channel #mchat)";
 int connect_function(ui_state_t *state, char *str)
 {
+    if (!state->mchat)
+    {
+        status_line_urg_set(1, "The channel is managed by the shared daemon");
+        return -1;
+    }
     if (mchatv1_is_connected(state->mchat))
     {
         char channel_name[2048];
@@ -261,6 +317,11 @@ int disconnect_function(ui_state_t *state, char *ptr)
 {
     // There may be a bug here (got a segfault once)
     // I have not been able to replicate it though -Sean
+    if (!state->mchat)
+    {
+        status_line_urg_set(1, "The channel is managed by the shared daemon");
+        return -1;
+    }
     if (!mchatv1_is_connected(state->mchat))
     {
         status_line_urg_set(1, "Already Disconnected!");
@@ -279,9 +340,147 @@ int disconnect_function(ui_state_t *state, char *ptr)
 }
 
 
+// Columns of the peer table, in display order
+enum peer_column { PEER_NICK, PEER_CHANNEL, PEER_SEEN, PEER_RATE, PEER_JITTER, PEER_SKEW, PEER_COLUMNS };
+static const char *peer_column_names[PEER_COLUMNS] = { "Nicknames", "Connected Channel", "Last Seen", "Rate", "Jitter", "Clock Skew" };
+
+typedef struct peer_sort_row {
+    peer_row_t *row;
+    const peer_stats_t *stats;	// NULL if we have never received a message from this peer
+} peer_sort_row_t;
+
+static int peer_sort_column;
+
+
+// Numeric columns put peers without statistics last and the largest values first
+static int peer_compare_stat(double a, double b, int a_valid, int b_valid)
+{
+    if (a_valid != b_valid)
+        return b_valid - a_valid;
+    return a < b ? 1 : a > b ? -1 : 0;
+}
+
+
+static int peer_compare(const void *pa, const void *pb)
+{
+    const peer_sort_row_t *a = pa, *b = pb;
+    int a_stats = a->stats != NULL, b_stats = b->stats != NULL;
+    int a_stamped = a_stats && a->stats->stamped, b_stamped = b_stats && b->stats->stamped;
+    switch (peer_sort_column)
+    {
+        case PEER_CHANNEL:
+            return strcasecmp(a->row->chan, b->row->chan);
+        case PEER_SEEN:
+            return a->row->last_seen < b->row->last_seen ? 1 : a->row->last_seen > b->row->last_seen ? -1 : 0;
+        case PEER_RATE:
+            return peer_compare_stat(a_stats ? peer_stats_rate(a->stats) : 0, b_stats ? peer_stats_rate(b->stats) : 0,
+                a_stats && a->stats->count > 1, b_stats && b->stats->count > 1);
+        case PEER_JITTER:
+            return peer_compare_stat(a_stamped ? a->stats->jitter_usec : 0, b_stamped ? b->stats->jitter_usec : 0, a_stamped, b_stamped);
+        case PEER_SKEW:
+        {
+            // Skew in either direction is equally interesting
+            double a_skew = a_stamped ? a->stats->skew_usec : 0, b_skew = b_stamped ? b->stats->skew_usec : 0;
+            return peer_compare_stat(a_skew < 0 ? -a_skew : a_skew, b_skew < 0 ? -b_skew : b_skew, a_stamped, b_stamped);
+        }
+        default:
+            return strcasecmp(a->row->nick, b->row->nick);
+    }
+}
+
+
+// Redraw the peer table - called by the main loop every iteration while \PEERLIST is open
+static void peerlist_draw(ui_state_t *state, ui_overlay_t *o)
+{
+    modal_view_t *view = o->data;
+
+    if (view->line > 1)
+    {
+        for (int i = 1; i < view->line; i++)
+        {
+            for (unsigned int c = 0; c < PEER_COLUMNS; c++)
+            {
+                wmove(view->wins[c], i, 0);
+                wclrtoeol(view->wins[c]);
+            }
+        }
+    }
+    for (unsigned int c = 0; c < PEER_COLUMNS; c++)
+    {
+        WINDOW *col = view->wins[c];
+        if (c < PEER_COLUMNS - 1)
+            wborder(col, ' ', 0, ' ', ' ', ' ', ' ', ' ',' ');
+        wmove(col, 0, 0);
+        wclrtoeol(col);
+        wattron(col, A_BOLD | (c == (unsigned int)view->sort ? A_UNDERLINE : 0));
+        mvwprintw(col, 0, 0, "%s", peer_column_names[c]);
+        wattroff(col, A_BOLD | A_UNDERLINE);
+    }
+
+    view->line = 1;
+    peer_row_t *rows;
+    unsigned int count = ui_get_peers(&rows);
+    peer_sort_row_t *sorted = count ? malloc(count * sizeof(peer_sort_row_t)) : NULL;
+    if (!sorted)
+    {
+        free(rows);
+        return;
+    }
+    for (unsigned int i = 0; i < count; i++)
+    {
+        nick_entry_t *peer = nick_lookup(state->nicks, rows[i].nick);
+        sorted[i].row = &rows[i];
+        sorted[i].stats = peer && peer->stats.count ? &peer->stats : NULL;
+    }
+    peer_sort_column = view->sort;
+    qsort(sorted, count, sizeof(peer_sort_row_t), peer_compare);
+
+    long now = time(NULL);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        peer_row_t *row = sorted[i].row;
+        const peer_stats_t *stats = sorted[i].stats;
+        mvwprintw(view->wins[PEER_NICK], view->line, 0, "%s (@%s)", row->nick, row->ip);
+        mvwprintw(view->wins[PEER_CHANNEL], view->line, 0, "%s", row->chan);
+        mvwprintw(view->wins[PEER_SEEN], view->line, 0, "%ld seconds ago", now - (row->last_seen / 1000000));
+        if (stats && stats->count > 1)
+            mvwprintw(view->wins[PEER_RATE], view->line, 0, "%.2f/s", peer_stats_rate(stats));
+        else
+            mvwprintw(view->wins[PEER_RATE], view->line, 0, "-");
+        if (stats && stats->stamped)
+        {
+            mvwprintw(view->wins[PEER_JITTER], view->line, 0, "%.1f ms", stats->jitter_usec / 1000);
+            mvwprintw(view->wins[PEER_SKEW], view->line, 0, "%+.1f ms", stats->skew_usec / 1000);
+        }
+        else
+        {
+            mvwprintw(view->wins[PEER_JITTER], view->line, 0, "-");
+            mvwprintw(view->wins[PEER_SKEW], view->line, 0, "-");
+        }
+        view->line = getcury(view->wins[PEER_NICK]) + 1;
+    }
+    free(sorted);
+    free(rows);
+}
+
+
+// TAB and the arrow keys change the sort column, anything else closes the table
+static int peerlist_key(ui_state_t *state, ui_overlay_t *o, int key)
+{
+    modal_view_t *view = o->data;
+    if (key == '\t' || key == KEY_RIGHT)
+        view->sort = (view->sort + 1) % PEER_COLUMNS;
+    else if (key == KEY_BTAB || key == KEY_LEFT)
+        view->sort = (view->sort + PEER_COLUMNS - 1) % PEER_COLUMNS;
+    else
+        return 1;
+    return 0;
+}
+
+
 const char *peerlist_string = "peerlist";
 const char *peerlist_syntax = "\\PEERLIST";
-const char *peerlist_help = "show a list of seen peers on a network";
+const char *peerlist_help = "show a list of seen peers on a network with their message rate, jitter and clock skew";
 int peerlist_function(ui_state_t *state, char *ptr)
 {
 
@@ -289,197 +488,126 @@ int peerlist_function(ui_state_t *state, char *ptr)
     int x, y, bx, by;
     getmaxyx(list_win, y, x);
     getbegyx(list_win, by, bx);
-    WINDOW *name_win = subwin(list_win, y - 3, x / 3 - 1, by + 1, bx + 2);
-    WINDOW *channel_win = subwin(list_win, y - 3, x / 3 - 1, by + 1, bx + 2 + x / 3);
-    WINDOW *time_win = subwin(list_win, y - 3, x / 3 - 3, by + 1, bx + 2 + x / 3 + x / 3);
+
+    // Column widths as a percentage of the table
+    static const int widths[PEER_COLUMNS] = { 25, 20, 16, 13, 13, 13 };
+    WINDOW *subs[PEER_COLUMNS];
+    int col = bx + 2;
+    for (unsigned int c = 0; c < PEER_COLUMNS; c++)
+    {
+        int width = (x - 4) * widths[c] / 100;
+        subs[c] = subwin(list_win, y - 3, width - 1, by + 1, col);
+        col += width;
+    }
     box(list_win, 0, 0);
     touchwin(list_win);
+
+    char *footer = "TAB to change the sort column, any other key to continue...";
+    mvwprintw(list_win, y - 2, (x / 2) - (strlen(footer) / 2), footer);
+
+    return modal_open(list_win, subs, PEER_COLUMNS, peerlist_key, peerlist_draw);
+}
+
+
+// Channels with the most members first
+static int channel_compare(const void *pa, const void *pb)
+{
+    const channel_entry_t *a = *(const channel_entry_t * const *)pa, *b = *(const channel_entry_t * const *)pb;
+    if (a->members != b->members)
+        return a->members < b->members ? 1 : -1;
+    return strcasecmp(a->name, b->name);
+}
+
+
+// Redraw the channel directory, but only when it has changed or the "seconds ago" column needs updating
+static void chanlist_draw(ui_state_t *state, ui_overlay_t *o)
+{
+    modal_view_t *view = o->data;
+    WINDOW *name_win = view->wins[0];
+    WINDOW *members_win = view->wins[1];
+    WINDOW *time_win = view->wins[2];
+
+    // The directory is only refreshed while it is on screen, and straight away when a peer list
+    // requested from the shared daemon comes in
+    long now = time(NULL);
+    if (now - view->scanned >= CURSES_UI_CHANNEL_SCAN_MS / 1000 || view->peers_serial != state->daemon_peers_serial)
+    {
+        view->scanned = now;
+        view->peers_serial = state->daemon_peers_serial;
+        ui_scan_channels();
+    }
+    unsigned long version = channel_dir_version(state->channels);
+    if (view->line > 0 && version == view->version && now == view->drawn)
+        return;
+    view->version = version;
+    view->drawn = now;
+
+    for (int i = 1; i < view->line; i++)
+    {
+        wmove(name_win, i, 0);
+        wclrtoeol(name_win);
+        wmove(members_win, i, 0);
+        wclrtoeol(members_win);
+        wmove(time_win, i, 0);
+        wclrtoeol(time_win);
+    }
     wborder(name_win, ' ', 0, ' ', ' ', ' ', ' ', ' ',' ');
-    wborder(channel_win, ' ', 0, ' ', ' ', ' ', ' ', ' ',' ');
-    wrefresh(name_win);
-    wrefresh(channel_win);
-    wrefresh(time_win);
+    wborder(members_win, ' ', 0, ' ', ' ', ' ', ' ', ' ',' ');
     wattron(name_win, A_BOLD);
-    wattron(channel_win, A_BOLD);
+    wattron(members_win, A_BOLD);
     wattron(time_win, A_BOLD);
-    mvwprintw(name_win, 0, 0, "Nicknames");
-    mvwprintw(channel_win, 0, 0, "Connected Channel");
-    mvwprintw(time_win, 0, 0, "Last Seen");
+    mvwprintw(name_win, 0, 0, "Channel");
+    mvwprintw(members_win, 0, 0, "Members");
+    mvwprintw(time_win, 0, 0, "Last Active");
     wattroff(name_win, A_BOLD);
-    wattroff(channel_win, A_BOLD);
+    wattroff(members_win, A_BOLD);
     wattroff(time_win, A_BOLD);
 
-    char *footer = "Press any key to continue...";
-    mvwprintw(list_win, y - 2, (x / 2) - (strlen(footer) / 2), footer);
-    // Print headings
-    int ret = 0;
-    int line = 0;
-    while ((ret = wgetch(list_win)) == ERR)
+    view->line = 1;
+    unsigned int count = channel_dir_count(state->channels);
+    const channel_entry_t **sorted = count ? malloc(count * sizeof(channel_entry_t *)) : NULL;
+    if (!sorted)
+        return;
+    for (unsigned int i = 0; i < count; i++)
+        sorted[i] = channel_dir_get(state->channels, i);
+    qsort(sorted, count, sizeof(channel_entry_t *), channel_compare);
+
+    // Only the rows that fit are drawn
+    int rows = getmaxy(name_win);
+    for (unsigned int i = 0; i < count && view->line < rows; i++)
     {
-        if (line > 1)
-        {
-            for (int i = 1; i < line; i++)
-            {
-                wmove(name_win, i, 0);
-                wclrtoeol(name_win);
-                wmove(channel_win, i, 0);
-                wclrtoeol(channel_win);
-                wmove(time_win, i, 0);
-                wclrtoeol(time_win);
-            }
-        }
-        wborder(name_win, ' ', 0, ' ', ' ', ' ', ' ', ' ',' ');
-        wborder(channel_win, ' ', 0, ' ', ' ', ' ', ' ', ' ',' ');
-        wattron(name_win, A_BOLD);
-        wattron(channel_win, A_BOLD);
-        wattron(time_win, A_BOLD);
-        mvwprintw(name_win, 0, 0, "Nicknames");
-        mvwprintw(channel_win, 0, 0, "Connected Channel");
-        mvwprintw(time_win, 0, 0, "Last Seen");
-        wattroff(name_win, A_BOLD);
-        wattroff(channel_win, A_BOLD);
-        wattroff(time_win, A_BOLD);
-        line = 1;
-        mchat_peerlist_t *pl;
-        if (mchatv1_get_peerlist(state->mchat, &pl))
-        {
-            for (int i = 0; i < mchatv1_peerlist_get_size(pl); i++)
-            {
-                char nick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];
-                char chan[MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE];
-                long t;
-                long now = time(NULL);
-                int r;
-                if ((r = mchatv1_peer_get_peer(pl, i, nick, chan, MCHAT_LIMIT_MAX_NICKNAME_SIZE, MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE, &t)))
-                    mvwprintw(name_win, line, 0, "Error: %d", r);
-                else
-                {
-                    unsigned char ip[16];
-                    mchatv1_peer_get_source_address(pl, i, ip, 16);
-                    mvwprintw(name_win, line, 0, "%s (@%s)", nick, ip);
-                    mvwprintw(channel_win, line, 0, chan);
-                    mvwprintw(time_win, line, 0, "%d seconds ago", now - (t/1000000));
-                }
-                line = getcury(name_win) + 1;
-            }
-        }
-        mchatv1_peerlist_destroy(&pl);
-
-        wrefresh(name_win);
-        wrefresh(channel_win);
-        wrefresh(time_win);
+        mvwprintw(name_win, view->line, 0, "%s", sorted[i]->name);
+        mvwprintw(members_win, view->line, 0, "%u", sorted[i]->members);
+        mvwprintw(time_win, view->line, 0, "%ld seconds ago", now - (sorted[i]->last_seen / 1000000));
+        view->line = getcury(name_win) + 1;
     }
-    delwin(name_win);
-    delwin(channel_win);
-    delwin(time_win);
-    delwin(list_win);
-    werase(stdscr);
-    refresh();
-    return ret;
-    return 0;
+    free(sorted);
 }
 
 
 const char *chanlist_string = "chanlist";
 const char *chanlist_syntax = "\\CHANLIST";
-const char *chanlist_help = "show a list of channels discovered through CDSC messages";
+const char *chanlist_help = "show a list of channels discovered on the network";
 int chanlist_function(ui_state_t *state, char *ptr)
 {
-
     WINDOW *list_win = newwin(state->max_line - 2, state->max_col - 2, 1, 1);
     int x, y, bx, by;
     getmaxyx(list_win, y, x);
     getbegyx(list_win, by, bx);
-    WINDOW *name_win = subwin(list_win, y - 3, x / 3 - 1, by + 1, bx + 2);
-    WINDOW *ip_win = subwin(list_win, y - 3, x / 3 - 1, by + 1, bx + 2 + x / 3);
-    WINDOW *port_win = subwin(list_win, y - 3, x / 3 - 3, by + 1, bx + 2 + x / 3 + x / 3);
+    WINDOW *name_win = subwin(list_win, y - 3, x / 2 - 1, by + 1, bx + 2);
+    WINDOW *members_win = subwin(list_win, y - 3, x / 6 - 1, by + 1, bx + 2 + x / 2);
+    WINDOW *time_win = subwin(list_win, y - 3, x / 3 - 3, by + 1, bx + 2 + x / 2 + x / 6);
     box(list_win, 0, 0);
     touchwin(list_win);
-    wborder(name_win, ' ', 0, ' ', ' ', ' ', ' ', ' ',' ');
-    wborder(ip_win, ' ', 0, ' ', ' ', ' ', ' ', ' ',' ');
-    wrefresh(name_win);
-    wrefresh(ip_win);
-    wrefresh(port_win);
-    wattron(name_win, A_BOLD);
-    wattron(ip_win, A_BOLD);
-    wattron(port_win, A_BOLD);
-    mvwprintw(name_win, 0, 0, "Nicknames");
-    mvwprintw(ip_win, 0, 0, "Connected Channel");
-    mvwprintw(port_win, 0, 0, "Last Seen");
-    wattroff(name_win, A_BOLD);
-    wattroff(ip_win, A_BOLD);
-    wattroff(port_win, A_BOLD);
 
     char *footer = "Press any key to continue...";
     mvwprintw(list_win, y - 2, (x / 2) - (strlen(footer) / 2), footer);
-    // Print headings
-    int ret = 0;
-    int line = 0;
-    while ((ret = wgetch(list_win)) == ERR)
-    {
-        if (line > 1)
-        {
-            for (int i = 1; i < line; i++)
-            {
-                wmove(name_win, i, 0);
-                wclrtoeol(name_win);
-                wmove(ip_win, i, 0);
-                wclrtoeol(ip_win);
-                wmove(port_win, i, 0);
-                wclrtoeol(port_win);
-            }
-        }
-        wborder(name_win, ' ', 0, ' ', ' ', ' ', ' ', ' ',' ');
-        wborder(ip_win, ' ', 0, ' ', ' ', ' ', ' ', ' ',' ');
-        wattron(name_win, A_BOLD);
-        wattron(ip_win, A_BOLD);
-        wattron(port_win, A_BOLD);
-        mvwprintw(name_win, 0, 0, "Nicknames");
-        mvwprintw(ip_win, 0, 0, "Connected Channel");
-        mvwprintw(port_win, 0, 0, "Last Seen");
-        wattroff(name_win, A_BOLD);
-        wattroff(ip_win, A_BOLD);
-        wattroff(port_win, A_BOLD);
-        line = 1;
-        mchat_peerlist_t *pl;
-        if (mchatv1_get_peerlist(state->mchat, &pl))
-        {
-            for (int i = 0; i < mchatv1_peerlist_get_size(pl); i++)
-            {
-                char nick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];
-                char chan[MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE];
-                long t;
-                long now = time(NULL);
-                int r;
-                if ((r = mchatv1_peer_get_peer(pl, i, nick, chan, MCHAT_LIMIT_MAX_NICKNAME_SIZE, MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE, &t)))
-                    mvwprintw(name_win, line, 0, "Error: %d", r);
-                else
-                {
-                    unsigned char ip[16];
-                    mchatv1_peer_get_source_address(pl, i, ip, 16);
-                    mvwprintw(name_win, line, 0, "%s (@%s)", nick, ip);
-                    mvwprintw(ip_win, line, 0, chan);
-                    mvwprintw(port_win, line, 0, "%d seconds ago", now - (t/1000000));
-                }
-                line = getcury(name_win) + 1;
-            }
-        }
-        mchatv1_peerlist_destroy(&pl);
 
-        wrefresh(name_win);
-        wrefresh(ip_win);
-        wrefresh(port_win);
-    }
-    delwin(name_win);
-    delwin(ip_win);
-    delwin(port_win);
-    delwin(list_win);
-    werase(stdscr);
-    refresh();
-    return ret;
-    return 0;
+    WINDOW *subs[3] = { name_win, members_win, time_win };
+    return modal_open(list_win, subs, 3, modal_any_key, chanlist_draw);
 }
 
+
 void load_builtin_cmds(ui_state_t *state)
 {
     add_cmd(help_string, help_syntax, help_help, help_function);
@@ -490,4 +618,5 @@ void load_builtin_cmds(ui_state_t *state)
     add_cmd(connect_string, connect_syntax, connect_help, connect_function);
     add_cmd(disconnect_string, disconnect_syntax, disconnect_help, disconnect_function);
     add_cmd(peerlist_string, peerlist_syntax, peerlist_help, peerlist_function);
+    add_cmd(chanlist_string, chanlist_syntax, chanlist_help, chanlist_function);
 }
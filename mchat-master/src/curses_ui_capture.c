@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "curses_ui_capture.h"
+#include "curses_ui_nicks.h"
+
+static const char capture_magic[4] = { 'M', 'C', 'A', 'P' };
+
+struct capture {
+    FILE *fp;
+
+    // writer: which nickname ids have been defined in this file
+    unsigned char *defined;
+    unsigned int defined_size;
+
+    // reader: nickname definitions indexed by id
+    char **names;
+    unsigned int name_count;
+};
+
+
+static void put_le(unsigned char *buf, unsigned long long v, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        buf[i] = (unsigned char)(v >> (8 * i));
+}
+
+
+static unsigned long long get_le(const unsigned char *buf, int bytes)
+{
+    unsigned long long v = 0;
+    for (int i = 0; i < bytes; i++)
+        v |= (unsigned long long)buf[i] << (8 * i);
+    return v;
+}
+
+
+// Read a length-prefixed string into buf, truncating (but consuming) anything longer than size - 1
+static int read_str(FILE *fp, char *buf, size_t size, size_t len)
+{
+    size_t keep = len < size ? len : size - 1;
+    if (fread(buf, 1, keep, fp) != keep)
+        return -1;
+    buf[keep] = '\0';
+    if (len > keep && fseek(fp, len - keep, SEEK_CUR) != 0)
+        return -1;
+    return 0;
+}
+
+
+capture_t *capture_open_write(const char *path)
+{
+    capture_t *c = calloc(1, sizeof(capture_t));
+    if (!c)
+        return NULL;
+    c->fp = fopen(path, "wb");
+    if (!c->fp)
+    {
+        free(c);
+        return NULL;
+    }
+    unsigned char version = CURSES_UI_CAPTURE_VERSION;
+    if (fwrite(capture_magic, 1, 4, c->fp) != 4 || fwrite(&version, 1, 1, c->fp) != 1)
+    {
+        capture_close(&c);
+        return NULL;
+    }
+    return c;
+}
+
+
+capture_t *capture_open_read(const char *path)
+{
+    capture_t *c = calloc(1, sizeof(capture_t));
+    if (!c)
+        return NULL;
+    c->fp = fopen(path, "rb");
+    if (!c->fp)
+    {
+        free(c);
+        return NULL;
+    }
+    char magic[4];
+    unsigned char version;
+    if (fread(magic, 1, 4, c->fp) != 4 || memcmp(magic, capture_magic, 4) != 0
+        || fread(&version, 1, 1, c->fp) != 1 || version != CURSES_UI_CAPTURE_VERSION)
+    {
+        capture_close(&c);
+        return NULL;
+    }
+    return c;
+}
+
+
+void capture_close(capture_t **c)
+{
+    if (!c || !*c)
+        return;
+    if ((*c)->fp)
+        fclose((*c)->fp);
+    for (unsigned int i = 0; i < (*c)->name_count; i++)
+        free((*c)->names[i]);
+    free((*c)->names);
+    free((*c)->defined);
+    free(*c);
+    *c = NULL;
+}
+
+
+// Write an 'N' record the first time a nickname id is used in this file
+static int define_nick(capture_t *c, unsigned int nick_id, const char *nick)
+{
+    if (nick_id < c->defined_size && c->defined[nick_id])
+        return 0;
+    if (nick_id >= c->defined_size)
+    {
+        unsigned int size = c->defined_size ? c->defined_size : 64;
+        while (size <= nick_id)
+            size *= 2;
+        unsigned char *defined = realloc(c->defined, size);
+        if (!defined)
+            return -1;
+        memset(defined + c->defined_size, 0, size - c->defined_size);
+        c->defined = defined;
+        c->defined_size = size;
+    }
+
+    size_t nick_len = strlen(nick);
+    if (nick_len > 0xffff)
+        return -1;
+    unsigned char hdr[7];
+    hdr[0] = 'N';
+    put_le(hdr + 1, nick_id, 4);
+    put_le(hdr + 5, nick_len, 2);
+    if (fwrite(hdr, 1, sizeof(hdr), c->fp) != sizeof(hdr) || fwrite(nick, 1, nick_len, c->fp) != nick_len)
+        return -1;
+    c->defined[nick_id] = 1;
+    return 0;
+}
+
+
+int capture_write(capture_t *c, long long usec, unsigned int nick_id, const char *nick, const char *source, const char *body)
+{
+    size_t source_len = strlen(source);
+    size_t body_len = strlen(body);
+    if (source_len > 0xffff || body_len > 0xffffffffUL)
+        return -1;
+    if (define_nick(c, nick_id, nick) != 0)
+        return -1;
+
+    unsigned char hdr[19];
+    hdr[0] = 'M';
+    put_le(hdr + 1, (unsigned long long)usec, 8);
+    put_le(hdr + 9, nick_id, 4);
+    put_le(hdr + 13, source_len, 2);
+    put_le(hdr + 15, body_len, 4);
+    if (fwrite(hdr, 1, sizeof(hdr), c->fp) != sizeof(hdr)
+        || fwrite(source, 1, source_len, c->fp) != source_len
+        || fwrite(body, 1, body_len, c->fp) != body_len)
+        return -1;
+    return 0;
+}
+
+
+int capture_flush(capture_t *c)
+{
+    return fflush(c->fp) == 0 ? 0 : -1;
+}
+
+
+void capture_forget_nick(capture_t *c, unsigned int nick_id)
+{
+    if (nick_id < c->defined_size)
+        c->defined[nick_id] = 0;
+}
+
+
+// Read an 'N' record body and remember the nickname under its id
+static int read_nick(capture_t *c)
+{
+    unsigned char hdr[6];
+    if (fread(hdr, 1, sizeof(hdr), c->fp) != sizeof(hdr))
+        return -1;
+    unsigned int id = get_le(hdr, 4);
+    size_t len = get_le(hdr + 4, 2);
+    if (id >= CURSES_UI_MAX_NICKS)
+        return -1;
+    if (id >= c->name_count)
+    {
+        char **names = realloc(c->names, (id + 1) * sizeof(char *));
+        if (!names)
+            return -1;
+        memset(names + c->name_count, 0, (id + 1 - c->name_count) * sizeof(char *));
+        c->names = names;
+        c->name_count = id + 1;
+    }
+    char *name = malloc(len + 1);
+    if (!name || read_str(c->fp, name, len + 1, len) != 0)
+    {
+        free(name);
+        return -1;
+    }
+    free(c->names[id]);
+    c->names[id] = name;
+    return 0;
+}
+
+
+int capture_read(capture_t *c, capture_record_t *rec)
+{
+    int tag;
+    while ((tag = fgetc(c->fp)) == 'N')
+    {
+        if (read_nick(c) != 0)
+            return -1;
+    }
+    if (tag == EOF)
+        return feof(c->fp) ? 0 : -1;
+    if (tag != 'M')
+        return -1;
+
+    unsigned char hdr[18];
+    if (fread(hdr, 1, sizeof(hdr), c->fp) != sizeof(hdr))
+        return -1;
+    rec->usec = (long long)get_le(hdr, 8);
+    unsigned int id = get_le(hdr + 8, 4);
+    if (id >= c->name_count || !c->names[id])
+        return -1;
+    strncpy(rec->nick, c->names[id], sizeof(rec->nick) - 1);
+    rec->nick[sizeof(rec->nick) - 1] = '\0';
+    if (read_str(c->fp, rec->source, sizeof(rec->source), get_le(hdr + 12, 2)) != 0
+        || read_str(c->fp, rec->body, sizeof(rec->body), get_le(hdr + 14, 4)) != 0)
+        return -1;
+    return 1;
+}
+
+
+unsigned long capture_memory(capture_t *c)
+{
+    unsigned long total = sizeof(capture_t) + BUFSIZ + c->defined_size + c->name_count * sizeof(char *);
+    for (unsigned int i = 0; i < c->name_count; i++)
+    {
+        if (c->names[i])
+            total += strlen(c->names[i]) + 1;
+    }
+    return total;
+}
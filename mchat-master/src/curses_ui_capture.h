@@ -0,0 +1,48 @@
+#ifndef CURSES_UI_CAPTURE_H
+#define CURSES_UI_CAPTURE_H
+
+/*
+ * Traffic capture files for the mchat curses ui.
+ *
+ * A capture file starts with the 4 byte magic "MCAP" and a version byte, followed by tagged records:
+ *
+ * 'N' nickname definition: nickname id (4 bytes), length (2 bytes), nickname
+ * 'M' received message: arrival time in microseconds since the epoch (8 bytes), nickname id (4 bytes),
+ *     source and body lengths (2 and 4 bytes), source, body
+ *
+ * Nicknames are interned (see curses_ui_nicks.h), so each one is written once, before the first message
+ * that refers to it.  An id that is reused for another nickname is simply defined again.  Strings are stored without terminators and all integers are little-endian so
+ * captures can be moved between hosts.
+ */
+
+#include <mchatv1.h>
+
+#define CURSES_UI_CAPTURE_VERSION 2
+
+typedef struct capture capture_t;
+
+typedef struct capture_record {
+    long long usec;
+    char nick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];
+    char source[MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE];
+    char body[MCHAT_LIMIT_MAX_MESSAGE_SIZE];
+} capture_record_t;
+
+capture_t *capture_open_write(const char *path);
+capture_t *capture_open_read(const char *path);
+void capture_close(capture_t **c);
+
+// Returns 0 on success, -1 on error
+int capture_write(capture_t *c, long long usec, unsigned int nick_id, const char *nick, const char *source, const char *body);
+int capture_flush(capture_t *c);
+
+// The nickname id now belongs to somebody else, so define it again before its next message
+void capture_forget_nick(capture_t *c, unsigned int nick_id);
+
+// Returns 1 when a message was read, 0 at end of file and -1 on a malformed file
+int capture_read(capture_t *c, capture_record_t *rec);
+
+// Bytes allocated for the capture, counting a BUFSIZ stdio buffer for the file
+unsigned long capture_memory(capture_t *c);
+
+#endif // CURSES_UI_CAPTURE_H
@@ -0,0 +1,200 @@
+#include <stdlib.h>
+#include <string.h>
+#include "curses_ui_channels.h"
+
+#define CHANNEL_DIR_INITIAL_BUCKETS 64
+
+struct channel_dir {
+    channel_entry_t *entries;
+    unsigned int count;
+    unsigned int capacity;
+
+    // open addressing hash of entry indexes + 1 (0 is an empty slot)
+    unsigned int *buckets;
+    unsigned int bucket_count;	// always a power of two
+
+    unsigned long scan;
+    unsigned long version;
+};
+
+
+// FNV-1a
+static unsigned int channel_hash(const char *name)
+{
+    unsigned int h = 2166136261u;
+    for (const char *p = name; *p; p++)
+    {
+        h ^= (unsigned char)*p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+
+static void fill_buckets(channel_dir_t *d, unsigned int *buckets, unsigned int bucket_count)
+{
+    memset(buckets, 0, bucket_count * sizeof(unsigned int));
+    for (unsigned int i = 0; i < d->count; i++)
+    {
+        unsigned int slot = d->entries[i].hash & (bucket_count - 1);
+        while (buckets[slot])
+            slot = (slot + 1) & (bucket_count - 1);
+        buckets[slot] = i + 1;
+    }
+}
+
+
+static int rehash(channel_dir_t *d, unsigned int bucket_count)
+{
+    unsigned int *buckets = malloc(bucket_count * sizeof(unsigned int));
+    if (!buckets)
+        return -1;
+    fill_buckets(d, buckets, bucket_count);
+    free(d->buckets);
+    d->buckets = buckets;
+    d->bucket_count = bucket_count;
+    return 0;
+}
+
+
+channel_dir_t *channel_dir_create()
+{
+    channel_dir_t *d = calloc(1, sizeof(channel_dir_t));
+    if (!d)
+        return NULL;
+    if (rehash(d, CHANNEL_DIR_INITIAL_BUCKETS) != 0)
+    {
+        free(d);
+        return NULL;
+    }
+    return d;
+}
+
+
+void channel_dir_destroy(channel_dir_t **d)
+{
+    if (!d || !*d)
+        return;
+    free((*d)->entries);
+    free((*d)->buckets);
+    free(*d);
+    *d = NULL;
+}
+
+
+void channel_dir_begin_scan(channel_dir_t *d)
+{
+    d->scan++;
+}
+
+
+static channel_entry_t *channel_find_or_add(channel_dir_t *d, const char *name)
+{
+    unsigned int hash = channel_hash(name);
+    unsigned int slot = hash & (d->bucket_count - 1);
+    for (; d->buckets[slot]; slot = (slot + 1) & (d->bucket_count - 1))
+    {
+        channel_entry_t *e = &d->entries[d->buckets[slot] - 1];
+        if (e->hash == hash && strcmp(e->name, name) == 0)
+            return e;
+    }
+
+    if (d->count == CURSES_UI_MAX_CHANNELS || d->count + 1 >= d->bucket_count)
+        return NULL;
+    if (d->count == d->capacity)
+    {
+        unsigned int capacity = d->capacity ? d->capacity * 2 : 16;
+        channel_entry_t *entries = realloc(d->entries, capacity * sizeof(channel_entry_t));
+        if (!entries)
+            return NULL;
+        d->entries = entries;
+        d->capacity = capacity;
+    }
+    channel_entry_t *e = &d->entries[d->count];
+    memset(e, 0, sizeof(channel_entry_t));
+    e->hash = hash;
+    strncpy(e->name, name, MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE - 1);
+    d->buckets[slot] = ++d->count;
+    d->version++;
+
+    // Keep the load factor under 1/2
+    if (d->count * 2 > d->bucket_count)
+        rehash(d, d->bucket_count * 2);
+    return e;
+}
+
+
+void channel_dir_add_peer(channel_dir_t *d, const char *channel, long last_seen, long long now_ms)
+{
+    if (!channel[0])
+        return;
+    channel_entry_t *e = channel_find_or_add(d, channel);
+    if (!e)
+        return;
+    if (e->scan != d->scan)
+    {
+        e->scan = d->scan;
+        e->scan_members = 0;
+    }
+    e->scan_members++;
+    e->refreshed_ms = now_ms;
+    if (last_seen > e->last_seen)
+    {
+        e->last_seen = last_seen;
+        d->version++;
+    }
+}
+
+
+void channel_dir_end_scan(channel_dir_t *d, long long now_ms)
+{
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < d->count; i++)
+    {
+        channel_entry_t *e = &d->entries[i];
+        unsigned int members = e->scan == d->scan ? e->scan_members : 0;
+        if (e->members != members)
+        {
+            e->members = members;
+            d->version++;
+        }
+        if (now_ms - e->refreshed_ms >= CURSES_UI_CHANNEL_EXPIRE_MS)
+            continue;
+        if (kept != i)
+            d->entries[kept] = *e;
+        kept++;
+    }
+    if (kept == d->count)
+        return;
+
+    // Entries expired, so the hash has to be rebuilt around the compacted array
+    d->count = kept;
+    d->version++;
+    fill_buckets(d, d->buckets, d->bucket_count);
+}
+
+
+unsigned int channel_dir_count(channel_dir_t *d)
+{
+    return d->count;
+}
+
+
+const channel_entry_t *channel_dir_get(channel_dir_t *d, unsigned int i)
+{
+    if (i >= d->count)
+        return NULL;
+    return &d->entries[i];
+}
+
+
+unsigned long channel_dir_version(channel_dir_t *d)
+{
+    return d->version;
+}
+
+
+unsigned long channel_dir_memory(channel_dir_t *d)
+{
+    return sizeof(channel_dir_t) + d->capacity * sizeof(channel_entry_t) + d->bucket_count * sizeof(unsigned int);
+}
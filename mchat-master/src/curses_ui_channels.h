@@ -0,0 +1,45 @@
+#ifndef CURSES_UI_CHANNELS_H
+#define CURSES_UI_CHANNELS_H
+
+/*
+ * Directory of channels discovered on the network.
+ *
+ * libmchat does not hand CDSC channel announcements to its users, so channels are discovered from the
+ * channel each peer reports in the peer list.  A scan (begin, one add per peer, end) only runs while the
+ * \CHANLIST view is open, every CURSES_UI_CHANNEL_SCAN_MS rather than every frame.  Entries live in a hash
+ * table keyed by channel name and are dropped once no peer has reported them for
+ * CURSES_UI_CHANNEL_EXPIRE_MS.  The directory version changes whenever an entry is added, removed or
+ * updated, so views only redraw when there is something new to show.
+ */
+
+#include <mchatv1.h>
+
+#define CURSES_UI_CHANNEL_SCAN_MS 2000
+#define CURSES_UI_CHANNEL_EXPIRE_MS 60000
+#define CURSES_UI_MAX_CHANNELS 4096
+
+typedef struct channel_entry {
+    unsigned int hash;
+    unsigned int members;		// peers on the channel in the last scan (0 if it did not see the channel)
+    unsigned int scan_members;		// peers counted so far in the current scan
+    unsigned long scan;			// last scan that saw the channel
+    long last_seen;			// most recent peer activity, microseconds since the epoch
+    long long refreshed_ms;		// monotonic time of the last scan that saw the channel
+    char name[MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE];
+} channel_entry_t;
+
+typedef struct channel_dir channel_dir_t;
+
+channel_dir_t *channel_dir_create();
+void channel_dir_destroy(channel_dir_t **d);
+
+void channel_dir_begin_scan(channel_dir_t *d);
+void channel_dir_add_peer(channel_dir_t *d, const char *channel, long last_seen, long long now_ms);
+void channel_dir_end_scan(channel_dir_t *d, long long now_ms);
+
+unsigned int channel_dir_count(channel_dir_t *d);
+const channel_entry_t *channel_dir_get(channel_dir_t *d, unsigned int i);
+unsigned long channel_dir_version(channel_dir_t *d);
+unsigned long channel_dir_memory(channel_dir_t *d);
+
+#endif // CURSES_UI_CHANNELS_H
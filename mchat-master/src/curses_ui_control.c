@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "curses_ui_internal.h"
+
+/*
+ * Local control socket
+ *
+ * Scripts connect to a Unix domain socket and send frames (see curses_ui_sock.h).  Every request gets
+ * exactly one OK or ERR reply carrying the request's sequence number on that connection:
+ *
+ *   CMD <command>		run through run_cmd()	-> OK|ERR <seq> <status text>
+ *   MSG <body>			send to the channel	-> OK|ERR <seq>
+ *   PEERS			peer list		-> PEER <nick> <chan> <ip> <last_seen_usec> ... OK <seq> <count>
+ *
+ * Commands are written with their escape character, which must itself be escaped on the wire (a \NICK
+ * request is sent as "CMD\t\\NICK\n").  Commands that open a view on the terminal (\HELP, \LIST,
+ * \PEERLIST, ...) have nothing to send back and are refused.
+ *
+ * When the ui is attached to a shared daemon, a PEERS request is answered with a list fetched from the
+ * daemon after the request arrived.  Requests behind it on the same connection wait for that answer so
+ * replies stay in order.
+ *
+ * The socket is serviced from the main loop.  Everything a client has sent is read and executed in
+ * one pass, and all of the replies go back in a single write.
+ *
+ * Anybody connected can run commands and send messages as this user, so the socket is created with
+ * mode CURSES_UI_CONTROL_SOCK_MODE (0600): only its owner may connect.
+ */
+
+#define CURSES_UI_CONTROL_SOCK_MODE 0600
+
+// Upper bound on reads per client per pass, so one client cannot starve the ui
+#define CURSES_UI_CONTROL_MAX_READS 64
+
+
+static void control_drop(ui_state_t *s, unsigned int i)
+{
+    sock_conn_destroy(&s->control_clients[i].conn);
+    s->control_clients[i] = s->control_clients[--s->control_client_count];
+}
+
+
+static int control_add(ui_state_t *s, sock_conn_t *c)
+{
+    if (s->control_client_count == s->control_client_cap)
+    {
+        unsigned int cap = s->control_client_cap ? s->control_client_cap * 2 : 4;
+        control_client_t *clients = realloc(s->control_clients, cap * sizeof(control_client_t));
+        if (!clients)
+            return -1;
+        s->control_clients = clients;
+        s->control_client_cap = cap;
+    }
+    control_client_t *client = &s->control_clients[s->control_client_count++];
+    client->conn = c;
+    client->seq = 0;
+    client->peers_wait = 0;
+    return 0;
+}
+
+
+static void control_reply(sock_conn_t *c, int ok, unsigned long seq, const char *detail)
+{
+    char seqstr[32];
+    snprintf(seqstr, sizeof(seqstr), "%lu", seq);
+    sock_conn_queue(c, ok ? "OK" : "ERR", seqstr, detail, NULL);
+}
+
+
+static void control_cmd(ui_state_t *s, sock_conn_t *c, unsigned long seq, char *cmd)
+{
+    // Whatever the command reports on the urgent status line becomes the reply text
+    if (s->status_line_urg_buf)
+        s->status_line_urg_buf[0] = '\0';
+    s->overlay_blocked = 1;
+    s->overlay_refused = 0;
+    int ret = run_cmd(cmd);
+    s->overlay_blocked = 0;
+    if (ret == -4096)
+        control_reply(c, 0, seq, "Unknown Command");
+    else if (s->overlay_refused)
+        control_reply(c, 0, seq, "Interactive Command");
+    else
+        control_reply(c, ret >= 0, seq, s->status_line_urg_buf ? s->status_line_urg_buf : "");
+}
+
+
+static void control_msg(ui_state_t *s, sock_conn_t *c, unsigned long seq, char *body)
+{
+    if (body[0] == '\0' || ui_send_message(body) < 0)
+    {
+        control_reply(c, 0, seq, "Send failed");
+        return;
+    }
+    char nick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];
+    ui_get_nickname(nick, MCHAT_LIMIT_MAX_NICKNAME_SIZE);
+    chat_win_print(nick, body);
+    control_reply(c, 1, seq, "");
+}
+
+
+static void control_peers_reply(ui_state_t *s, sock_conn_t *c, unsigned long seq)
+{
+    peer_row_t *rows;
+    unsigned int count = ui_get_peers(&rows);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        char last_seen[32];
+        snprintf(last_seen, sizeof(last_seen), "%ld", rows[i].last_seen);
+        sock_conn_queue(c, "PEER", rows[i].nick, rows[i].chan, rows[i].ip, last_seen, NULL);
+    }
+    free(rows);
+
+    char countstr[32];
+    snprintf(countstr, sizeof(countstr), "%u", count);
+    control_reply(c, 1, seq, countstr);
+}
+
+
+// Returns 1 if the reply has to wait for the shared daemon
+static int control_peers(ui_state_t *s, sock_conn_t *c, unsigned long seq, unsigned long *wait)
+{
+    if ((*wait = ui_request_peers()))
+        return 1;
+    control_peers_reply(s, c, seq);
+    return 0;
+}
+
+
+// Handle every complete request from a client, stopping at a PEERS request that waits for the daemon
+static void control_frames(ui_state_t *s, sock_conn_t *c, unsigned long *seq, unsigned long *wait)
+{
+    // The waiting request is always the last one handled, so its number is *seq - 1
+    if (*wait)
+    {
+        if (s->daemon && s->daemon_peers_serial < *wait)
+            return;
+        if (s->daemon)
+            control_peers_reply(s, c, *seq - 1);
+        else
+            control_reply(c, 0, *seq - 1, "Lost connection to the shared daemon");
+        *wait = 0;
+    }
+
+    char *fields[CURSES_UI_SOCK_MAX_FIELDS];
+    int count;
+    while ((count = sock_conn_next_frame(c, fields, CURSES_UI_SOCK_MAX_FIELDS)) > 0)
+    {
+        unsigned long n = (*seq)++;
+        if (strcmp(fields[0], "CMD") == 0 && count >= 2)
+            control_cmd(s, c, n, fields[1]);
+        else if (strcmp(fields[0], "MSG") == 0 && count >= 2)
+            control_msg(s, c, n, fields[1]);
+        else if (strcmp(fields[0], "PEERS") == 0)
+        {
+            if (control_peers(s, c, n, wait))
+                return;
+        }
+        else
+            control_reply(c, 0, n, "Unknown Request");
+    }
+}
+
+
+// Returns -1 if the client should be dropped
+static int control_client(ui_state_t *s, sock_conn_t *c, unsigned long *seq, unsigned long *wait)
+{
+    int got;
+    for (int i = 0; i < CURSES_UI_CONTROL_MAX_READS && (got = sock_conn_read(c)) != 0; i++)
+    {
+        if (got < 0)
+            return -1;
+    }
+
+    control_frames(s, c, seq, wait);
+    if (c->overflow || sock_conn_flush(c) != 0)
+        return -1;
+    return 0;
+}
+
+
+int control_start(ui_state_t *s, const char *path)
+{
+    control_stop(s);
+    s->control_fd = sock_listen_unix(path, CURSES_UI_CONTROL_SOCK_MODE);
+    if (s->control_fd < 0)
+        return -1;
+    s->control_path = strdup(path);
+    return 0;
+}
+
+
+void control_service(ui_state_t *s)
+{
+    if (s->control_fd < 0)
+        return;
+
+    int fd;
+    while ((fd = sock_accept(s->control_fd)) >= 0)
+    {
+        sock_conn_t *c = s->control_client_count < CURSES_UI_MAX_CONTROL_CLIENTS ? sock_conn_create(fd) : NULL;
+        if (!c || control_add(s, c) != 0)
+        {
+            if (c)
+                sock_conn_destroy(&c);
+            else
+                close(fd);
+            continue;
+        }
+    }
+
+    for (unsigned int i = s->control_client_count; i > 0; i--)
+    {
+        control_client_t *client = &s->control_clients[i - 1];
+        if (control_client(s, client->conn, &client->seq, &client->peers_wait) != 0)
+            control_drop(s, i - 1);
+    }
+}
+
+
+void control_stop(ui_state_t *s)
+{
+    while (s->control_client_count)
+        control_drop(s, s->control_client_count - 1);
+    free(s->control_clients);
+    s->control_clients = NULL;
+    s->control_client_cap = 0;
+    if (s->control_fd >= 0)
+        close(s->control_fd);
+    s->control_fd = -1;
+    if (s->control_path)
+        unlink(s->control_path);
+    free(s->control_path);
+    s->control_path = NULL;
+}
@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <sys/socket.h>
+#include <mchatv1.h>
+#include "curses_ui.h"
+#include "curses_ui_sock.h"
+#include "curses_ui_peers.h"
+
+/*
+ * Shared daemon mode
+ *
+ * One daemon owns the mchat endpoint (socket, receive processing and peer tracking) and serves any
+ * number of thin curses clients over a Unix domain socket.  Frames (see curses_ui_sock.h):
+ *
+ * client -> daemon
+ *   HELLO			announce a new client
+ *   SEND <body>		send body to the channel as this client
+ *   PEERS			request a peer list snapshot
+ *
+ * daemon -> client
+ *   NICK <nick>		the nickname this client sends as
+ *   STATUS <text>		connection status for the status line
+ *   MSG <nick> <body>		a received message (or one sent by another client)
+ *   PEER <nick> <chan> <ip> <last_seen_usec>
+ *   PEERS_END			end of a peer list snapshot
+ *   ERR <text>			a malformed request was ignored
+ *
+ * The endpoint has a single nickname, so the daemon switches it to the client's nickname before
+ * each send.  Any local user can connect to the socket, so clients do not get to pick their nickname:
+ * it is bound to the connecting user's login name (from SO_PEERCRED) when the connection is accepted.
+ * Sharing the endpoint between local users is the point of the daemon, so the socket is created with
+ * mode CURSES_UI_DAEMON_SOCK_MODE (0666) whatever the umask.
+ */
+
+#define CURSES_UI_DAEMON_SOCK_MODE 0666
+#define CURSES_UI_DAEMON_MAX_CLIENTS 256
+#define CURSES_UI_DAEMON_POLL_MS 20
+#define CURSES_UI_DAEMON_RECV_BATCH 1024
+
+typedef struct daemon_client {
+    sock_conn_t *conn;
+    char nick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];	// bound to the peer's user when accepted
+} daemon_client_t;
+
+typedef struct daemon_state {
+    mchat_t *mchat;
+    int listen_fd;
+    daemon_client_t clients[CURSES_UI_DAEMON_MAX_CLIENTS];
+    unsigned int client_count;
+    char nick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];
+    char status[MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE + 32];
+} daemon_state_t;
+
+static volatile sig_atomic_t daemon_running;
+
+
+static void daemon_stop(int sig)
+{
+    daemon_running = 0;
+}
+
+
+static void drop_client(daemon_state_t *d, unsigned int i)
+{
+    sock_conn_destroy(&d->clients[i].conn);
+    d->clients[i] = d->clients[--d->client_count];
+    memset(&d->clients[d->client_count], 0, sizeof(daemon_client_t));
+}
+
+
+// Name the client after the user on the other end of the socket.  Returns -1 if that cannot be found.
+static int bind_client_nick(int fd, char *nick, size_t len)
+{
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0)
+        return -1;
+
+    char buf[4096];
+    struct passwd pw, *found = NULL;
+    if (getpwuid_r(cred.uid, &pw, buf, sizeof(buf), &found) == 0 && found && found->pw_name[0])
+        snprintf(nick, len, "%s", found->pw_name);
+    else
+        snprintf(nick, len, "uid%u", (unsigned int)cred.uid);
+    return 0;
+}
+
+
+static void broadcast(daemon_state_t *d, daemon_client_t *except, const char *nick, const char *body)
+{
+    // A client that cannot keep up overflows its buffer and is dropped by the flush pass
+    for (unsigned int i = 0; i < d->client_count; i++)
+    {
+        if (&d->clients[i] != except)
+            sock_conn_queue(d->clients[i].conn, "MSG", nick, body, NULL);
+    }
+}
+
+
+static void send_peers(daemon_state_t *d, sock_conn_t *c)
+{
+    peer_row_t *rows;
+    unsigned int count = peer_rows_from_mchat(d->mchat, &rows);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        char last_seen[32];
+        snprintf(last_seen, sizeof(last_seen), "%ld", rows[i].last_seen);
+        sock_conn_queue(c, "PEER", rows[i].nick, rows[i].chan, rows[i].ip, last_seen, NULL);
+    }
+    sock_conn_queue(c, "PEERS_END", NULL);
+    free(rows);
+}
+
+
+static void handle_frames(daemon_state_t *d, daemon_client_t *client)
+{
+    sock_conn_t *c = client->conn;
+    char *fields[CURSES_UI_SOCK_MAX_FIELDS];
+    int count;
+    while ((count = sock_conn_next_frame(c, fields, CURSES_UI_SOCK_MAX_FIELDS)) > 0)
+    {
+        if (strcmp(fields[0], "HELLO") == 0)
+        {
+            sock_conn_queue(c, "NICK", client->nick, NULL);
+            sock_conn_queue(c, "STATUS", d->status, NULL);
+        }
+        else if (strcmp(fields[0], "SEND") == 0)
+        {
+            if (count != 2)
+            {
+                sock_conn_queue(c, "ERR", "SEND takes exactly one field, the message body", NULL);
+                continue;
+            }
+            const char *body = fields[1];
+            if (strcmp(client->nick, d->nick) != 0)
+            {
+                mchatv1_set_nickname(d->mchat, client->nick, strlen(client->nick));
+                strcpy(d->nick, client->nick);
+            }
+            mchatv1_send_message(d->mchat, body);
+            broadcast(d, client, client->nick, body);
+        }
+        else if (strcmp(fields[0], "PEERS") == 0)
+            send_peers(d, c);
+    }
+}
+
+
+int ui_daemon_run(const char *path)
+{
+    daemon_state_t d;
+    memset(&d, 0, sizeof(d));
+    d.listen_fd = sock_listen_unix(path, CURSES_UI_DAEMON_SOCK_MODE);
+    if (d.listen_fd < 0)
+    {
+        fprintf(stderr, "mchat: could not listen on %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    d.mchat = mchatv1_init(NULL);
+    if (!d.mchat || mchatv1_connect(d.mchat, NULL) != 0)
+    {
+        fprintf(stderr, "mchat: could not connect to the default channel\n");
+        if (d.mchat)
+            mchatv1_destroy(&d.mchat);
+        close(d.listen_fd);
+        unlink(path);
+        return -1;
+    }
+    char channel[MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE];
+    mchatv1_get_channel(d.mchat, channel, MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE);
+    mchatv1_get_nickname(d.mchat, d.nick, MCHAT_LIMIT_MAX_NICKNAME_SIZE);
+    snprintf(d.status, sizeof(d.status), "Connected to %s via %s", channel, path);
+
+    daemon_running = 1;
+    signal(SIGINT, daemon_stop);
+    signal(SIGTERM, daemon_stop);
+
+    struct pollfd fds[CURSES_UI_DAEMON_MAX_CLIENTS + 1];
+    while (daemon_running)
+    {
+        fds[0].fd = d.listen_fd;
+        fds[0].events = POLLIN;
+        for (unsigned int i = 0; i < d.client_count; i++)
+        {
+            fds[i + 1].fd = d.clients[i].conn->fd;
+            fds[i + 1].events = POLLIN | (d.clients[i].conn->out_len ? POLLOUT : 0);
+        }
+        // libmchat does not expose its socket, so the endpoint is polled on a short timeout
+        unsigned int polled = d.client_count;
+        if (poll(fds, polled + 1, CURSES_UI_DAEMON_POLL_MS) < 0)
+            continue;
+
+        // Service clients from the back so drop_client() does not disturb unvisited entries
+        for (unsigned int i = polled; i > 0; i--)
+        {
+            daemon_client_t *client = &d.clients[i - 1];
+            if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && sock_conn_read(client->conn) < 0)
+            {
+                drop_client(&d, i - 1);
+                continue;
+            }
+            handle_frames(&d, client);
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            int fd;
+            while ((fd = sock_accept(d.listen_fd)) >= 0)
+            {
+                daemon_client_t *client = &d.clients[d.client_count];
+                if (d.client_count == CURSES_UI_DAEMON_MAX_CLIENTS
+                    || bind_client_nick(fd, client->nick, sizeof(client->nick)) != 0
+                    || !(client->conn = sock_conn_create(fd)))
+                {
+                    close(fd);
+                    continue;
+                }
+                d.client_count++;
+            }
+        }
+
+        mchat_message_t *mesg;
+        for (int i = 0; i < CURSES_UI_DAEMON_RECV_BATCH && mchatv1_recv_message(d.mchat, &mesg) > 0; i++)
+        {
+            char recv_nick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];
+            char recv_mesg[MCHAT_LIMIT_MAX_MESSAGE_SIZE];
+            memset(recv_nick, 0, MCHAT_LIMIT_MAX_NICKNAME_SIZE);
+            memset(recv_mesg, 0, MCHAT_LIMIT_MAX_MESSAGE_SIZE);
+            mchatv1_message_get_body(mesg, recv_mesg, MCHAT_LIMIT_MAX_MESSAGE_SIZE);
+            mchatv1_message_get_nickname(mesg, recv_nick, MCHAT_LIMIT_MAX_NICKNAME_SIZE);
+            mchatv1_message_destroy(&mesg);
+            broadcast(&d, NULL, recv_nick, recv_mesg);
+        }
+
+        for (unsigned int i = d.client_count; i > 0; i--)
+        {
+            sock_conn_t *c = d.clients[i - 1].conn;
+            if (c->overflow || sock_conn_flush(c) != 0)
+                drop_client(&d, i - 1);
+        }
+    }
+
+    for (unsigned int i = d.client_count; i > 0; i--)
+        drop_client(&d, i - 1);
+    close(d.listen_fd);
+    unlink(path);
+    mchatv1_disconnect(d.mchat);
+    mchatv1_destroy(&d.mchat);
+    return 0;
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "curses_ui_frag.h"
+
+typedef struct frag_slot {
+    int used;
+    unsigned int sender;
+    unsigned int seq;
+    unsigned int count;
+    unsigned int received;
+    unsigned long long have;			// bitmap of received fragment indexes
+    size_t bytes;
+    long long started_ms;
+    char **parts;			// count entries, allocated when the slot is claimed
+} frag_slot_t;
+
+struct frag_table {
+    frag_slot_t slots[CURSES_UI_FRAG_SLOTS];
+    unsigned long completed;
+    unsigned long dropped;
+};
+
+
+const char *frag_parse(const char *body, frag_header_t *hdr)
+{
+    if (body[0] != CURSES_UI_FRAG_MARK || body[1] != 'F')
+        return NULL;
+    int len = 0;
+    if (sscanf(body + 2, "%x.%u.%u%n", &hdr->seq, &hdr->index, &hdr->count, &len) != 3)
+        return NULL;
+    if (body[2 + len] != CURSES_UI_FRAG_MARK)
+        return NULL;
+    if (hdr->count == 0 || hdr->count > CURSES_UI_FRAG_MAX_COUNT || hdr->index >= hdr->count)
+        return NULL;
+    return body + 3 + len;
+}
+
+
+int frag_format_header(char *buf, const frag_header_t *hdr)
+{
+    return snprintf(buf, CURSES_UI_FRAG_HEADER_MAX, "%cF%x.%u.%u%c", CURSES_UI_FRAG_MARK, hdr->seq, hdr->index, hdr->count, CURSES_UI_FRAG_MARK);
+}
+
+
+frag_table_t *frag_table_create()
+{
+    return calloc(1, sizeof(frag_table_t));
+}
+
+
+static void slot_clear(frag_slot_t *slot)
+{
+    for (unsigned int i = 0; slot->parts && i < slot->count; i++)
+        free(slot->parts[i]);
+    free(slot->parts);
+    memset(slot, 0, sizeof(frag_slot_t));
+}
+
+
+void frag_table_destroy(frag_table_t **t)
+{
+    if (!t || !*t)
+        return;
+    for (unsigned int i = 0; i < CURSES_UI_FRAG_SLOTS; i++)
+        slot_clear(&(*t)->slots[i]);
+    free(*t);
+    *t = NULL;
+}
+
+
+// Find the sender's slot, or claim a free one (evicting the oldest reassembly if none are free)
+static frag_slot_t *slot_for(frag_table_t *t, unsigned int sender)
+{
+    frag_slot_t *free_slot = NULL, *oldest = NULL;
+    for (unsigned int i = 0; i < CURSES_UI_FRAG_SLOTS; i++)
+    {
+        frag_slot_t *slot = &t->slots[i];
+        if (!slot->used)
+        {
+            if (!free_slot)
+                free_slot = slot;
+        }
+        else if (slot->sender == sender)
+            return slot;
+        else if (!oldest || slot->started_ms < oldest->started_ms)
+            oldest = slot;
+    }
+    if (free_slot)
+        return free_slot;
+    slot_clear(oldest);
+    t->dropped++;
+    return oldest;
+}
+
+
+char *frag_add(frag_table_t *t, unsigned int sender, const frag_header_t *hdr, const char *payload, long long now_ms)
+{
+    frag_slot_t *slot = slot_for(t, sender);
+    if (slot->used && (slot->seq != hdr->seq || slot->count != hdr->count))
+    {
+        // The sender moved on to a new message, so the old one will never complete
+        slot_clear(slot);
+        t->dropped++;
+    }
+    if (!slot->used)
+    {
+        if (!(slot->parts = calloc(hdr->count, sizeof(char *))))
+        {
+            t->dropped++;
+            return NULL;
+        }
+        slot->used = 1;
+        slot->sender = sender;
+        slot->seq = hdr->seq;
+        slot->count = hdr->count;
+        slot->started_ms = now_ms;
+    }
+
+    if (slot->have & (1ULL << hdr->index))
+        return NULL;
+    size_t len = strlen(payload);
+    if (slot->bytes + len > CURSES_UI_FRAG_MAX_MESSAGE || !(slot->parts[hdr->index] = strdup(payload)))
+    {
+        slot_clear(slot);
+        t->dropped++;
+        return NULL;
+    }
+    slot->have |= 1ULL << hdr->index;
+    slot->bytes += len;
+    if (++slot->received < slot->count)
+        return NULL;
+
+    char *message = malloc(slot->bytes + 1);
+    if (message)
+    {
+        size_t pos = 0;
+        for (unsigned int i = 0; i < slot->count; i++)
+        {
+            size_t part_len = strlen(slot->parts[i]);
+            memcpy(message + pos, slot->parts[i], part_len);
+            pos += part_len;
+        }
+        message[pos] = '\0';
+        t->completed++;
+    }
+    else
+        t->dropped++;
+    slot_clear(slot);
+    return message;
+}
+
+
+void frag_expire(frag_table_t *t, long long now_ms)
+{
+    for (unsigned int i = 0; i < CURSES_UI_FRAG_SLOTS; i++)
+    {
+        if (t->slots[i].used && now_ms - t->slots[i].started_ms >= CURSES_UI_FRAG_TIMEOUT_MS)
+        {
+            slot_clear(&t->slots[i]);
+            t->dropped++;
+        }
+    }
+}
+
+
+void frag_forget(frag_table_t *t, unsigned int sender)
+{
+    for (unsigned int i = 0; i < CURSES_UI_FRAG_SLOTS; i++)
+    {
+        if (t->slots[i].used && t->slots[i].sender == sender)
+        {
+            slot_clear(&t->slots[i]);
+            t->dropped++;
+        }
+    }
+}
+
+
+unsigned long frag_completed(frag_table_t *t)
+{
+    return t->completed;
+}
+
+
+unsigned long frag_dropped(frag_table_t *t)
+{
+    return t->dropped;
+}
+
+
+unsigned long frag_table_memory(frag_table_t *t)
+{
+    unsigned long total = sizeof(frag_table_t);
+    for (unsigned int i = 0; i < CURSES_UI_FRAG_SLOTS; i++)
+    {
+        if (t->slots[i].used)
+            total += t->slots[i].count * sizeof(char *) + t->slots[i].bytes + t->slots[i].received;
+    }
+    return total;
+}
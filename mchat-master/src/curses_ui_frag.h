@@ -0,0 +1,60 @@
+#ifndef CURSES_UI_FRAG_H
+#define CURSES_UI_FRAG_H
+
+/*
+ * Fragmentation and reassembly of messages longer than MCHAT_LIMIT_MAX_MESSAGE_SIZE.
+ *
+ * A long message is sent as a numbered series of ordinary mchat messages, each starting (after the
+ * reordering stamp, see curses_ui_reorder.h) with a small header:
+ * "\x1f" "F" <message sequence, hex> "." <fragment index> "." <fragment count> "\x1f".
+ * Receivers collect fragments per sender in a bounded reassembly slot and hand the message on once every
+ * fragment has arrived.  Slots that do not complete within CURSES_UI_FRAG_TIMEOUT_MS are dropped, and
+ * when every slot is busy the oldest is evicted, so incomplete messages never hold up or grow the
+ * receive path.  Clients without fragment support simply show the fragments as separate messages.
+ */
+
+#include <mchatv1.h>
+#include "curses_ui_reorder.h"
+
+#define CURSES_UI_FRAG_MARK '\x1f'
+#define CURSES_UI_FRAG_HEADER_MAX 32
+#define CURSES_UI_FRAG_PAYLOAD (MCHAT_LIMIT_MAX_MESSAGE_SIZE - 1 - CURSES_UI_REORDER_STAMP_MAX - CURSES_UI_FRAG_HEADER_MAX)
+#define CURSES_UI_FRAG_MAX_COUNT 64
+#define CURSES_UI_FRAG_MAX_MESSAGE (CURSES_UI_FRAG_MAX_COUNT * CURSES_UI_FRAG_PAYLOAD)
+#define CURSES_UI_FRAG_SLOTS 32
+#define CURSES_UI_FRAG_TIMEOUT_MS 5000
+
+typedef struct frag_header {
+    unsigned int seq;
+    unsigned int index;
+    unsigned int count;
+} frag_header_t;
+
+typedef struct frag_table frag_table_t;
+
+// Parse a fragment header.  Returns a pointer to the payload, or NULL if body is not a fragment.
+const char *frag_parse(const char *body, frag_header_t *hdr);
+
+// Write the header for one fragment into buf (at least CURSES_UI_FRAG_HEADER_MAX bytes), returns its length
+int frag_format_header(char *buf, const frag_header_t *hdr);
+
+frag_table_t *frag_table_create();
+void frag_table_destroy(frag_table_t **t);
+
+// Add a fragment from sender.  Returns the complete message (caller frees) once the last fragment arrives.
+char *frag_add(frag_table_t *t, unsigned int sender, const frag_header_t *hdr, const char *payload, long long now_ms);
+
+// Drop reassemblies older than CURSES_UI_FRAG_TIMEOUT_MS
+void frag_expire(frag_table_t *t, long long now_ms);
+
+// Drop the reassembly in progress for sender, if any
+void frag_forget(frag_table_t *t, unsigned int sender);
+
+// Counters since the table was created
+unsigned long frag_completed(frag_table_t *t);
+unsigned long frag_dropped(frag_table_t *t);
+
+// Bytes allocated for the table and any partial messages it holds
+unsigned long frag_table_memory(frag_table_t *t);
+
+#endif // CURSES_UI_FRAG_H
@@ -0,0 +1,288 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "curses_ui_highlight.h"
+
+/*
+ * Automaton layout
+ *
+ * Input bytes are first folded to lower case and mapped to a small set of character classes: one
+ * class per distinct byte that appears in any pattern plus class 0 for everything else.  This keeps
+ * the full DFA transition table (nodes * classes) small even with hundreds of patterns.  Each node
+ * records the length of the longest pattern ending there, following fail links, so a scan only has
+ * to look at one table entry per input byte.
+ */
+
+struct highlighter {
+    // pattern set: the nickname and the watch-words
+    char *nick;
+    char **words;
+    unsigned int word_count;
+    unsigned int word_cap;
+
+    // compiled automaton
+    int dirty;
+    unsigned char cls[256];
+    unsigned int ncls;
+    unsigned int node_count;
+    unsigned int node_cap;  // nodes allocated
+    int *next;              // node_count * ncls transitions
+    unsigned int *out_len;  // longest pattern length ending at node (0 for none)
+};
+
+
+static void add_pattern_classes(highlighter_t *h, const char *p)
+{
+    for (; *p; p++)
+    {
+        unsigned char c = (unsigned char)tolower((unsigned char)*p);
+        if (h->cls[c] == 0)
+            h->cls[c] = h->ncls++;
+    }
+}
+
+
+static void insert_pattern(highlighter_t *h, const char *p)
+{
+    unsigned int len = strlen(p);
+    int node = 0;
+    for (unsigned int i = 0; i < len; i++)
+    {
+        unsigned char c = h->cls[(unsigned char)tolower((unsigned char)p[i])];
+        int *slot = &h->next[node * h->ncls + c];
+        if (*slot == 0)
+            *slot = h->node_count++;
+        node = *slot;
+    }
+    if (len > h->out_len[node])
+        h->out_len[node] = len;
+}
+
+
+static void free_automaton(highlighter_t *h)
+{
+    free(h->next);
+    free(h->out_len);
+    h->next = NULL;
+    h->out_len = NULL;
+    h->node_count = 0;
+    h->node_cap = 0;
+}
+
+
+// Build the trie, then turn it into a full DFA with a breadth first walk over the fail links
+static int compile(highlighter_t *h)
+{
+    free_automaton(h);
+    memset(h->cls, 0, sizeof(h->cls));
+    h->ncls = 1;
+
+    unsigned int total = 1;
+    if (h->nick)
+    {
+        add_pattern_classes(h, h->nick);
+        total += strlen(h->nick);
+    }
+    for (unsigned int i = 0; i < h->word_count; i++)
+    {
+        add_pattern_classes(h, h->words[i]);
+        total += strlen(h->words[i]);
+    }
+    // Fold upper case bytes onto their lower case class
+    for (int c = 'A'; c <= 'Z'; c++)
+        h->cls[c] = h->cls[tolower(c)];
+
+    h->next = calloc((size_t)total * h->ncls, sizeof(int));
+    h->out_len = calloc(total, sizeof(unsigned int));
+    int *fail = calloc(total, sizeof(int));
+    int *queue = malloc(total * sizeof(int));
+    if (!h->next || !h->out_len || !fail || !queue)
+    {
+        free(fail);
+        free(queue);
+        free_automaton(h);
+        return -1;
+    }
+
+    h->node_cap = total;
+    h->node_count = 1;
+    if (h->nick)
+        insert_pattern(h, h->nick);
+    for (unsigned int i = 0; i < h->word_count; i++)
+        insert_pattern(h, h->words[i]);
+
+    unsigned int head = 0, tail = 0;
+    for (unsigned int c = 0; c < h->ncls; c++)
+    {
+        int child = h->next[c];
+        if (child)
+        {
+            fail[child] = 0;
+            queue[tail++] = child;
+        }
+    }
+    while (head < tail)
+    {
+        int node = queue[head++];
+        if (h->out_len[fail[node]] > h->out_len[node])
+            h->out_len[node] = h->out_len[fail[node]];
+        for (unsigned int c = 0; c < h->ncls; c++)
+        {
+            int *slot = &h->next[node * h->ncls + c];
+            int via_fail = h->next[fail[node] * h->ncls + c];
+            if (*slot)
+            {
+                fail[*slot] = via_fail;
+                queue[tail++] = *slot;
+            }
+            else
+                *slot = via_fail;
+        }
+    }
+
+    free(fail);
+    free(queue);
+    h->dirty = 0;
+    return 0;
+}
+
+
+highlighter_t *highlighter_create()
+{
+    highlighter_t *h = calloc(1, sizeof(highlighter_t));
+    if (h)
+        h->dirty = 1;
+    return h;
+}
+
+
+void highlighter_destroy(highlighter_t **h)
+{
+    if (!h || !*h)
+        return;
+    free_automaton(*h);
+    free((*h)->nick);
+    for (unsigned int i = 0; i < (*h)->word_count; i++)
+        free((*h)->words[i]);
+    free((*h)->words);
+    free(*h);
+    *h = NULL;
+}
+
+
+int highlighter_set_nick(highlighter_t *h, const char *nick)
+{
+    char *copy = NULL;
+    if (nick && nick[0])
+    {
+        copy = strdup(nick);
+        if (!copy)
+            return -1;
+    }
+    free(h->nick);
+    h->nick = copy;
+    h->dirty = 1;
+    return 0;
+}
+
+
+int highlighter_add_word(highlighter_t *h, const char *word)
+{
+    if (!word || !word[0] || h->word_count == CURSES_UI_MAX_HIGHLIGHT_WORDS)
+        return -1;
+    for (unsigned int i = 0; i < h->word_count; i++)
+    {
+        if (strcasecmp(h->words[i], word) == 0)
+            return 0;
+    }
+    if (h->word_count == h->word_cap)
+    {
+        unsigned int cap = h->word_cap ? h->word_cap * 2 : 8;
+        char **words = realloc(h->words, cap * sizeof(char *));
+        if (!words)
+            return -1;
+        h->words = words;
+        h->word_cap = cap;
+    }
+    char *copy = strdup(word);
+    if (!copy)
+        return -1;
+    h->words[h->word_count++] = copy;
+    h->dirty = 1;
+    return 0;
+}
+
+
+int highlighter_del_word(highlighter_t *h, const char *word)
+{
+    for (unsigned int i = 0; i < h->word_count; i++)
+    {
+        if (strcasecmp(h->words[i], word) == 0)
+        {
+            free(h->words[i]);
+            h->words[i] = h->words[--h->word_count];
+            h->dirty = 1;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+
+unsigned int highlighter_word_count(highlighter_t *h)
+{
+    return h->word_count;
+}
+
+
+const char *highlighter_get_word(highlighter_t *h, unsigned int i)
+{
+    if (i >= h->word_count)
+        return NULL;
+    return h->words[i];
+}
+
+
+unsigned int highlighter_scan(highlighter_t *h, const char *text, highlight_match_t *matches, unsigned int max)
+{
+    if (h->dirty && compile(h) != 0)
+        return 0;
+    if (h->node_count <= 1 || max == 0)
+        return 0;
+
+    unsigned int count = 0;
+    int node = 0;
+    for (unsigned int i = 0; text[i]; i++)
+    {
+        node = h->next[node * h->ncls + h->cls[(unsigned char)text[i]]];
+        unsigned int len = h->out_len[node];
+        if (len == 0)
+            continue;
+
+        unsigned int start = i + 1 - len;
+        // Merge with any earlier regions this match overlaps or touches
+        while (count > 0 && start <= matches[count - 1].start + matches[count - 1].len)
+        {
+            if (matches[count - 1].start < start)
+                start = matches[count - 1].start;
+            count--;
+        }
+        if (count == max)
+            break;
+        matches[count].start = start;
+        matches[count].len = i + 1 - start;
+        count++;
+    }
+    return count;
+}
+
+
+unsigned long highlighter_memory(highlighter_t *h)
+{
+    unsigned long total = sizeof(highlighter_t) + h->word_cap * sizeof(char *);
+    if (h->nick)
+        total += strlen(h->nick) + 1;
+    for (unsigned int i = 0; i < h->word_count; i++)
+        total += strlen(h->words[i]) + 1;
+    return total + (unsigned long)h->node_cap * (h->ncls * sizeof(int) + sizeof(unsigned int));
+}
@@ -0,0 +1,40 @@
+#ifndef CURSES_UI_HIGHLIGHT_H
+#define CURSES_UI_HIGHLIGHT_H
+
+/*
+ * Multi-pattern highlight engine for the mchat curses ui.
+ *
+ * The current nickname and a user supplied list of watch-words are compiled into a single
+ * Aho-Corasick automaton, so every incoming message body is scanned once no matter how many
+ * patterns are loaded.  Matching is case-insensitive.  The automaton is rebuilt lazily on the
+ * next scan after the pattern set changes.
+ */
+
+#define CURSES_UI_MAX_HIGHLIGHT_WORDS 1024
+#define CURSES_UI_MAX_HIGHLIGHTS 64
+
+typedef struct highlighter highlighter_t;
+
+// A highlighted region of a scanned string (overlapping matches are merged)
+typedef struct highlight_match {
+    unsigned int start;
+    unsigned int len;
+} highlight_match_t;
+
+highlighter_t *highlighter_create();
+void highlighter_destroy(highlighter_t **h);
+
+// Pattern management - all return 0 on success, -1 on error
+int highlighter_set_nick(highlighter_t *h, const char *nick);
+int highlighter_add_word(highlighter_t *h, const char *word);
+int highlighter_del_word(highlighter_t *h, const char *word);
+unsigned int highlighter_word_count(highlighter_t *h);
+const char *highlighter_get_word(highlighter_t *h, unsigned int i);
+
+// Scan text in one pass, filling at most max regions.  Returns the number of regions found.
+unsigned int highlighter_scan(highlighter_t *h, const char *text, highlight_match_t *matches, unsigned int max);
+
+// Bytes allocated for the pattern set and compiled automaton
+unsigned long highlighter_memory(highlighter_t *h);
+
+#endif // CURSES_UI_HIGHLIGHT_H
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "curses_ui_internal.h"
+
+/* highlight commands implemented
+ * -highlight - manage the watch-word list used to highlight incoming messages
+ */
+
+
+const char *highlight_string = "highlight";
+const char *highlight_syntax = "\\HIGHLIGHT [ADD WORD|DEL WORD|LIST|RESET]";
+const char *highlight_help = "Manage watch-words highlighted in incoming messages (your nickname is always highlighted)";
+int highlight_function(ui_state_t *state, char *str)
+{
+    char *ptr = str + strlen(highlight_string);
+    while (isspace(ptr[0])) ptr++;
+
+    if (ptr[0] == 0 || match_keyword(ptr, "list"))
+    {
+        unsigned int count = highlighter_word_count(state->highlighter);
+        if (count == 0)
+        {
+            status_line_urg_set(1, "No watch-words set");
+            return 0;
+        }
+        // Show as many words as fit on the status line
+        char buf[1024];
+        int len = snprintf(buf, sizeof(buf), "%u watch-words:", count);
+        for (unsigned int i = 0; i < count && len < (int)sizeof(buf); i++)
+            len += snprintf(buf + len, sizeof(buf) - len, " %s", highlighter_get_word(state->highlighter, i));
+        status_line_urg_set(1, "%s", buf);
+        return 0;
+    }
+    else if (match_keyword(ptr, "reset"))
+    {
+        state->hl_count = 0;
+        status_line_urg_set(1, "Highlight count reset");
+        return 0;
+    }
+
+    char *word = match_keyword(ptr, "add");
+    int add = word != NULL;
+    if (!add)
+        word = match_keyword(ptr, "del");
+    if (!word)
+    {
+        status_line_urg_set(1, "\\HIGHLIGHT ERROR: Invalid Argument");
+        return -1;
+    }
+    if (word[0] == 0)
+    {
+        status_line_urg_set(1, "\\HIGHLIGHT ERROR: Missing watch-word");
+        return -1;
+    }
+
+    if (add)
+    {
+        if (highlighter_add_word(state->highlighter, word) != 0)
+        {
+            status_line_urg_set(1, "\\HIGHLIGHT ERROR: Could not add %s", word);
+            return -1;
+        }
+        status_line_urg_set(1, "Highlighting %s", word);
+    }
+    else
+    {
+        if (highlighter_del_word(state->highlighter, word) != 0)
+        {
+            status_line_urg_set(1, "\\HIGHLIGHT ERROR: %s is not a watch-word", word);
+            return -1;
+        }
+        status_line_urg_set(1, "No longer highlighting %s", word);
+    }
+    return 0;
+}
+
+
+void load_highlight_cmds(ui_state_t *state)
+{
+    add_cmd(highlight_string, highlight_syntax, highlight_help, highlight_function);
+}
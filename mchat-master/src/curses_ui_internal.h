@@ -13,8 +13,11 @@
  * after themselves by freeing and malloc'd memory and deleting any windows they created.  If a command function
  * creates a new window, it should call werase(stdscr) and refresh() before returning.
  *
- * A special note on capturing input: command functions must return KEY_RESIZE if they received KEY_RESIZE while
- * running.  This ensures that ui_resize() is called when the main loop continues execution.
+ * A special note on capturing input: command functions must never block waiting for input, since the main loop
+ * is also responsible for receiving messages.  Commands that need a modal view (like \HELP or \LIST) should
+ * build a ui_overlay_t and hand it to overlay_open().  The main loop then routes keystrokes to the overlay's key
+ * function and calls its draw function every iteration until the overlay is closed.  KEY_RESIZE is handled by
+ * the main loop, which closes the overlay and calls ui_resize().
  *
  * One last note: The commands in builtin_cmds.c are considered to be part of the main mchat curses program.  There
  * should be very few commands implemented here.  Extra commands should be in a separate file with an appropriate
@@ -24,19 +27,66 @@
  */
 
 #include <ncurses.h>
+#include <time.h>
 #include <mchatv1.h>
+#include "curses_ui_highlight.h"
+#include "curses_ui_capture.h"
+#include "curses_ui_nicks.h"
+#include "curses_ui_timer.h"
+#include "curses_ui_sock.h"
+#include "curses_ui_peers.h"
+#include "curses_ui_frag.h"
+#include "curses_ui_channels.h"
 
-#define CURSES_UI_MAX_POSSIBLE_COMMANDS 1024
-#define CURSES_UI_MAX_POSSIBLE_RUNNABLES 1024
+#define CURSES_UI_MAX_CONTROL_CLIENTS 16
+
+// Longest message that can be typed, long messages are sent as fragments
+#define CURSES_UI_MAX_INPUT_SIZE (CURSES_UI_FRAG_MAX_MESSAGE < 16384 ? CURSES_UI_FRAG_MAX_MESSAGE : 16384)
+
+// The input and status line buffers start small and grow on demand up to these limits
+#define CURSES_UI_INPUT_INITIAL_SIZE 256
+#define CURSES_UI_STATUS_INITIAL_SIZE 128
+#define CURSES_UI_MAX_STATUS_SIZE 1024
 
 // UI state tracking structure
 // Used by the main UI program and cmd functions
 typedef struct ui_state ui_state_t;
 typedef int (*cmd_function)(ui_state_t *s, char *str);
-typedef int (*runnable)(ui_state_t *s);
+typedef timer_function runnable;	// return 0 to keep a periodic runnable scheduled
+
+// Modal overlay panels driven by the main loop
+typedef struct ui_overlay ui_overlay_t;
+typedef int (*overlay_key_function)(ui_state_t *s, ui_overlay_t *o, int key);	// return non-zero to close
+typedef void (*overlay_draw_function)(ui_state_t *s, ui_overlay_t *o);		// called every loop iteration
+typedef void (*overlay_free_function)(ui_state_t *s, ui_overlay_t *o);		// release data and sub-windows
+
+// Client of the local control socket
+typedef struct control_client {
+    sock_conn_t *conn;
+    unsigned long seq;			// next request number
+    unsigned long peers_wait;		// peer list serial a PEERS request waits for (0 if none)
+} control_client_t;
+
+// Registered command, see add_cmd()
+typedef struct ui_cmd {
+    const char *name;
+    unsigned int name_len;
+    cmd_function func;
+    const char *syntax;
+    const char *help;
+} ui_cmd_t;
+
+struct ui_overlay {
+    WINDOW *win;
+    void *data;
+    unsigned int data_size;	// bytes allocated for data, for \MEMSTAT
+    overlay_key_function key;
+    overlay_draw_function draw;
+    overlay_free_function free;
+};
 
 struct ui_state {
-    // mchat struct pointer
+    // mchat struct pointer (NULL when attached to a shared daemon)
     mchat_t *mchat;
 
     // Window pointers
@@ -64,14 +114,43 @@ struct ui_state {
 
     // chat_win options
     char *cw_print_fmt;
+    char *cw_print_head;		// cw_print_fmt before the nickname (NULL if not splittable)
+    char *cw_print_mid;			// cw_print_fmt between the nickname and the message
+    char *cw_print_tail;		// cw_print_fmt following the message
+    char cw_time_buf[128];		// cw_print_head formatted for cw_time_last
+    time_t cw_time_last;
+
+    // interned nicknames of everyone seen this session
+    nick_table_t *nicks;
+
+    // fragmentation of long messages
+    frag_table_t *frags;		// reassembly slots for received fragments
+    unsigned int frag_seq;		// sequence number of the next fragmented message we send
+
+    // reordering of received messages by sender sequence number
+    reorder_t *reorder;
+    ui_timer_t *reorder_timer;		// releases held messages when their hold time runs out
+    int reorder_enabled;
+    int stamp_outgoing;			// stamp the messages we send (off by default, older clients show the stamp)
+    unsigned int send_seq;		// sequence number stamped on the next message we send
 
-    // input buffer
-    char input_buf[MCHAT_LIMIT_MAX_MESSAGE_SIZE];
+    // channels discovered from the peer list
+    channel_dir_t *channels;
+
+    // mention and watch-word highlighting
+    highlighter_t *highlighter;
+    unsigned int hl_count;		// number of received messages with a highlight
+
+    // input buffer (grown as the line gets longer, shrunk again once it is sent)
+    char *input_buf;
     unsigned int input_buf_len;
+    unsigned int input_buf_cap;
 
     // status line buffers
-    char status_line_buf[1024];
-    char status_line_urg_buf[1024];
+    char *status_line_buf;
+    char *status_line_urg_buf;
+    unsigned int status_line_cap;
+    unsigned int status_line_urg_cap;
 
     // status line options
     char status_line_blink : 1;		// normal status line should blink (default: false)
@@ -83,35 +162,96 @@ struct ui_state {
     char status_line_urg_blink : 1;	// urgent status line should blink (default: false)
     char status_line_urg_flag4 : 1;	// reserved for future use
 
+    // traffic capture and replay
+    capture_t *capture;			// every received message is recorded here when set
+    capture_t *replay;			// capture file being fed back through the receive path
+    capture_record_t *replay_next;	// next record to deliver
+    ui_timer_t *replay_timer;
+    ui_timer_t *capture_timer;
+    double replay_speed;		// replay speed multiplier (0 is as fast as possible)
+    long long replay_rec_base;		// timestamp of the first replayed record
+    long long replay_wall_base;		// monotonic time replay started
+    unsigned long replay_count;
+
+    // shared daemon connection (NULL when this process owns its mchat endpoint)
+    sock_conn_t *daemon;
+    char daemon_nick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];
+    peer_row_t *daemon_peers;		// last complete peer list from the daemon
+    unsigned int daemon_peer_count;
+    unsigned int daemon_peers_cap;
+    peer_row_t *daemon_peers_next;	// peer list being received
+    unsigned int daemon_peers_next_count;
+    unsigned int daemon_peers_next_cap;
+    long long daemon_peers_requested;
+    unsigned long daemon_peers_serial;	// complete peer lists received so far
+    unsigned int daemon_peers_pending;	// PEERS requests the daemon has not answered yet
+
+    // local control socket (control_fd is -1 when disabled)
+    int control_fd;
+    char *control_path;
+    control_client_t *control_clients;	// grown as clients connect, up to CURSES_UI_MAX_CONTROL_CLIENTS
+    unsigned int control_client_count;
+    unsigned int control_client_cap;
+
+    // active modal overlay (NULL if none)
+    ui_overlay_t *overlay;
+    int overlay_blocked;		// set while running commands for a caller that cannot see the terminal
+    int overlay_refused;		// an overlay was discarded because overlay_blocked was set
+
     // run flag (1 is running, 0 is ready to exit)
     unsigned int running;
 
+    // screen drawn to /dev/null when running headless (NULL on a terminal)
+    SCREEN *headless_screen;
+    FILE *headless_in;
+    FILE *headless_out;
+
     // command list
+    ui_cmd_t *cmds;
     unsigned int cmd_count;
-    const char *cmd_names[CURSES_UI_MAX_POSSIBLE_COMMANDS];
-    const char *cmd_syntax[CURSES_UI_MAX_POSSIBLE_COMMANDS];
-    const char *cmd_help[CURSES_UI_MAX_POSSIBLE_COMMANDS];
-    cmd_function cmd_funcs[CURSES_UI_MAX_POSSIBLE_COMMANDS];
-
-    // main-loop runnables (not implemented yet)
-    //unsigned int runnable_count;
-    //runnable runnable_funcs[CURSES_UI_MAX_POSSIBLE_RUNNABLES];
+    unsigned int cmd_cap;
+
+    // main-loop runnables, scheduled on a timer wheel
+    timer_wheel_t *runnables;
 };
 
 
 // functions that are available to cmds are declared here
 void chat_win_print(char *nickname, char *message);
+void chat_win_print_hl(char *nickname, char *message, highlight_match_t *hl, unsigned int hl_count);
+void chat_win_print_peer(nick_entry_t *peer, char *message, highlight_match_t *hl, unsigned int hl_count);
 void status_line_set(char *str, ...);
 void status_line_urg_set(int now, char *str, ...);
 void status_line_urg_unset();
+int ui_send_message(char *body);
+void ui_get_nickname(char *buf, size_t len);
+void ui_set_nickname(char *nick);
+unsigned int ui_get_peers(peer_row_t **rows);	// caller frees *rows
+unsigned long ui_request_peers();
+void ui_recv_message(char *nick, char *body);	// feed a message into the receive path
+void ui_reorder_enable(int enable);
+void ui_scan_channels();
+void overlay_open(ui_overlay_t *o);	// takes ownership of a malloc'd overlay and its window
+void overlay_close();
+ui_timer_t *runnable_add(unsigned int delay_ms, unsigned int period_ms, runnable func, void *arg);
+void runnable_cancel(ui_timer_t *t);
 
 // general cmd functions
 int is_cmd(char *cmdstr);
 int run_cmd(char *cmdstr);
 int run_cmd_by_id(int id);
+char *match_keyword(char *str, const char *keyword);	// text after a leading whole-word keyword, or NULL
 void add_cmd(const char *cmdstr, const char *syntax, const char *help, cmd_function func);
 
+// local control socket, serviced from the main loop
+int control_start(ui_state_t *s, const char *path);
+void control_service(ui_state_t *s);
+void control_stop(ui_state_t *s);
+
 void load_builtin_cmds(ui_state_t *state);
+void load_highlight_cmds(ui_state_t *state);
+void load_reorder_cmds(ui_state_t *state);
+void load_memstat_cmds(ui_state_t *state);
 
 
 #endif // CURSES_UI_STATE_H
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <string.h>
+#include "curses_ui_internal.h"
+
+/* memory accounting commands implemented
+ * -memstat - report the memory held by this session
+ */
+
+
+static double kib(unsigned long bytes)
+{
+    return bytes / 1024.0;
+}
+
+
+const char *memstat_string = "memstat";
+const char *memstat_syntax = "\\MEMSTAT";
+const char *memstat_help = "Report the memory held by this session, in KiB (curses windows and libmchat are not included)";
+int memstat_function(ui_state_t *state, char *str)
+{
+    unsigned long cmds = state->cmd_cap * sizeof(ui_cmd_t);
+    unsigned long buffers = state->input_buf_cap + state->status_line_cap + state->status_line_urg_cap;
+    unsigned long nicks = nick_table_memory(state->nicks);
+    unsigned long highlight = highlighter_memory(state->highlighter);
+    unsigned long frags = frag_table_memory(state->frags);
+    unsigned long reorder = reorder_memory(state->reorder);
+    unsigned long channels = channel_dir_memory(state->channels);
+    unsigned long timers = timer_wheel_memory(state->runnables);
+
+    unsigned long capture = 0;
+    if (state->capture)
+        capture += capture_memory(state->capture);
+    if (state->replay)
+        capture += capture_memory(state->replay);
+    if (state->replay_next)
+        capture += sizeof(capture_record_t);
+
+    unsigned long overlay = 0;
+    if (state->overlay)
+        overlay = sizeof(ui_overlay_t) + state->overlay->data_size;
+
+    unsigned long peers = (state->daemon_peers_cap + state->daemon_peers_next_cap) * sizeof(peer_row_t);
+
+    unsigned long sockets = state->control_client_cap * sizeof(control_client_t);
+    if (state->daemon)
+        sockets += sock_conn_memory(state->daemon);
+    for (unsigned int i = 0; i < state->control_client_count; i++)
+        sockets += sock_conn_memory(state->control_clients[i].conn);
+
+    unsigned long total = sizeof(ui_state_t) + cmds + buffers + nicks + highlight + frags + reorder + channels + timers
+        + capture + overlay + peers + sockets;
+    status_line_urg_set(1, "Memory %.1f KiB: state %.1f, commands %.1f, buffers %.1f, nicks %.1f, highlight %.1f, "
+        "fragments %.1f, reorder %.1f, channels %.1f, timers %.1f, capture %.1f, overlay %.1f, peer lists %.1f, "
+        "sockets %.1f", kib(total), kib(sizeof(ui_state_t)), kib(cmds), kib(buffers), kib(nicks), kib(highlight),
+        kib(frags), kib(reorder), kib(channels), kib(timers), kib(capture), kib(overlay), kib(peers), kib(sockets));
+    return 0;
+}
+
+
+void load_memstat_cmds(ui_state_t *state)
+{
+    add_cmd(memstat_string, memstat_syntax, memstat_help, memstat_function);
+}
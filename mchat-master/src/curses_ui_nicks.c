@@ -0,0 +1,244 @@
+#include <stdlib.h>
+#include <string.h>
+#include "curses_ui_nicks.h"
+
+#define NICK_TABLE_INITIAL_BUCKETS 64
+
+struct nick_table {
+    nick_entry_t **entries;	// indexed by id
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int max;
+    unsigned long name_bytes;
+
+    // least recently used order, for eviction once count reaches max
+    nick_entry_t *newest;
+    nick_entry_t *oldest;
+    nick_evict_function evict;
+    void *arg;
+
+    // open addressing hash of entry ids + 1 (0 is an empty slot)
+    unsigned int *buckets;
+    unsigned int bucket_count;	// always a power of two
+};
+
+
+// FNV-1a
+static unsigned int nick_hash(const char *nick, unsigned int *len)
+{
+    unsigned int h = 2166136261u;
+    const char *p = nick;
+    for (; *p; p++)
+    {
+        h ^= (unsigned char)*p;
+        h *= 16777619u;
+    }
+    *len = p - nick;
+    return h;
+}
+
+
+static int rehash(nick_table_t *t, unsigned int bucket_count)
+{
+    unsigned int *buckets = calloc(bucket_count, sizeof(unsigned int));
+    if (!buckets)
+        return -1;
+    for (unsigned int i = 0; i < t->count; i++)
+    {
+        unsigned int slot = t->entries[i]->hash & (bucket_count - 1);
+        while (buckets[slot])
+            slot = (slot + 1) & (bucket_count - 1);
+        buckets[slot] = i + 1;
+    }
+    free(t->buckets);
+    t->buckets = buckets;
+    t->bucket_count = bucket_count;
+    return 0;
+}
+
+
+nick_table_t *nick_table_create(unsigned int max, nick_evict_function evict, void *arg)
+{
+    if (max == 0 || max > CURSES_UI_MAX_NICKS)
+        return NULL;
+    nick_table_t *t = calloc(1, sizeof(nick_table_t));
+    if (!t)
+        return NULL;
+    t->max = max;
+    t->evict = evict;
+    t->arg = arg;
+    if (rehash(t, NICK_TABLE_INITIAL_BUCKETS) != 0)
+    {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+
+void nick_table_destroy(nick_table_t **t)
+{
+    if (!t || !*t)
+        return;
+    for (unsigned int i = 0; i < (*t)->count; i++)
+        free((*t)->entries[i]);
+    free((*t)->entries);
+    free((*t)->buckets);
+    free(*t);
+    *t = NULL;
+}
+
+
+// Probe for nick, leaving *slot at its bucket or at the empty bucket where it would go
+static nick_entry_t *nick_find(nick_table_t *t, const char *nick, unsigned int hash, unsigned int len, unsigned int *slot)
+{
+    for (*slot = hash & (t->bucket_count - 1); t->buckets[*slot]; *slot = (*slot + 1) & (t->bucket_count - 1))
+    {
+        nick_entry_t *e = t->entries[t->buckets[*slot] - 1];
+        if (e->hash == hash && e->len == len && memcmp(e->name, nick, len) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+
+static void lru_unlink(nick_table_t *t, nick_entry_t *e)
+{
+    if (e->newer)
+        e->newer->older = e->older;
+    else
+        t->newest = e->older;
+    if (e->older)
+        e->older->newer = e->newer;
+    else
+        t->oldest = e->newer;
+}
+
+
+static void lru_push(nick_table_t *t, nick_entry_t *e)
+{
+    e->newer = NULL;
+    e->older = t->newest;
+    if (t->newest)
+        t->newest->newer = e;
+    else
+        t->oldest = e;
+    t->newest = e;
+}
+
+
+// Empty a bucket, shifting later entries of the same probe run back so that none of them become unreachable
+static void bucket_remove(nick_table_t *t, unsigned int slot)
+{
+    unsigned int mask = t->bucket_count - 1;
+    for (unsigned int next = (slot + 1) & mask; t->buckets[next]; next = (next + 1) & mask)
+    {
+        unsigned int home = t->entries[t->buckets[next] - 1]->hash & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask))
+        {
+            t->buckets[slot] = t->buckets[next];
+            slot = next;
+        }
+    }
+    t->buckets[slot] = 0;
+}
+
+
+// Drop the least recently used entry and return its id for reuse
+static unsigned int evict_oldest(nick_table_t *t)
+{
+    nick_entry_t *e = t->oldest;
+    if (t->evict)
+        t->evict(t->arg, e);
+    unsigned int slot = e->hash & (t->bucket_count - 1);
+    while (t->buckets[slot] != e->id + 1)
+        slot = (slot + 1) & (t->bucket_count - 1);
+    bucket_remove(t, slot);
+    lru_unlink(t, e);
+    unsigned int id = e->id;
+    t->entries[id] = NULL;
+    t->name_bytes -= e->len + 1;
+    free(e);
+    return id;
+}
+
+
+nick_entry_t *nick_intern(nick_table_t *t, const char *nick)
+{
+    unsigned int len, slot;
+    unsigned int hash = nick_hash(nick, &len);
+    nick_entry_t *found = nick_find(t, nick, hash, len, &slot);
+    if (found)
+    {
+        if (found != t->newest)
+        {
+            lru_unlink(t, found);
+            lru_push(t, found);
+        }
+        return found;
+    }
+
+    if (t->count < t->max && t->count + 1 >= t->bucket_count)
+        return NULL;
+    if (t->count < t->max && t->count == t->capacity)
+    {
+        unsigned int capacity = t->capacity ? t->capacity * 2 : 16;
+        nick_entry_t **entries = realloc(t->entries, capacity * sizeof(nick_entry_t *));
+        if (!entries)
+            return NULL;
+        t->entries = entries;
+        t->capacity = capacity;
+    }
+    nick_entry_t *e = calloc(1, sizeof(nick_entry_t) + len + 1);
+    if (!e)
+        return NULL;
+    if (t->count < t->max)
+        e->id = t->count++;
+    else
+    {
+        e->id = evict_oldest(t);
+        // The removal may have shifted buckets, so look for the one nick goes in again
+        nick_find(t, nick, hash, len, &slot);
+    }
+    e->hash = hash;
+    e->len = len;
+    memcpy(e->name, nick, len + 1);
+    t->entries[e->id] = e;
+    t->name_bytes += len + 1;
+    t->buckets[slot] = e->id + 1;
+    lru_push(t, e);
+
+    // Keep the load factor under 3/4
+    if (t->count * 4 > t->bucket_count * 3)
+        rehash(t, t->bucket_count * 2);
+    return e;
+}
+
+
+nick_entry_t *nick_lookup(nick_table_t *t, const char *nick)
+{
+    unsigned int len, slot;
+    unsigned int hash = nick_hash(nick, &len);
+    return nick_find(t, nick, hash, len, &slot);
+}
+
+
+nick_entry_t *nick_lookup_id(nick_table_t *t, unsigned int id)
+{
+    if (id >= t->count)
+        return NULL;
+    return t->entries[id];
+}
+
+
+unsigned int nick_table_count(nick_table_t *t)
+{
+    return t->count;
+}
+
+
+unsigned long nick_table_memory(nick_table_t *t)
+{
+    return sizeof(nick_table_t) + t->capacity * sizeof(nick_entry_t *) + t->bucket_count * sizeof(unsigned int)
+        + t->count * sizeof(nick_entry_t) + t->name_bytes;
+}
@@ -0,0 +1,48 @@
+#ifndef CURSES_UI_NICKS_H
+#define CURSES_UI_NICKS_H
+
+/*
+ * Interned nickname table for the mchat curses ui.
+ *
+ * Every distinct nickname seen during a session is stored once and given a small integer id (the capture
+ * log writes ids instead of repeating nicknames).  Entries also carry per-peer data that is expensive to
+ * recompute, such as the render attribute used in chat_win, and the peer's traffic statistics.  The table
+ * holds at most max entries; once it is full, the nickname that has gone longest without being interned is
+ * evicted to make room and its id is given to the new nickname.  The evict callback runs first, so anything kept per
+ * id elsewhere can be forgotten.  Entry pointers are therefore only valid until the next nick_intern() of
+ * a nickname that is not in the table.
+ */
+
+#include "curses_ui_stats.h"
+
+#define CURSES_UI_MAX_NICKS 65536
+
+typedef struct nick_entry {
+    unsigned int id;
+    unsigned int hash;
+    unsigned int len;
+    int attr_valid;		// attr has been assigned
+    unsigned long attr;		// cached chat_win render attribute (curses attr_t)
+    peer_stats_t stats;		// traffic statistics for messages from this nick
+    struct nick_entry *newer;	// least recently used order, kept by the table
+    struct nick_entry *older;
+    char name[];
+} nick_entry_t;
+
+typedef struct nick_table nick_table_t;
+
+// Called with an entry that is about to be evicted, while it is still in the table
+typedef void (*nick_evict_function)(void *arg, nick_entry_t *e);
+
+// max is at most CURSES_UI_MAX_NICKS
+nick_table_t *nick_table_create(unsigned int max, nick_evict_function evict, void *arg);
+void nick_table_destroy(nick_table_t **t);
+
+// Find or add nick, evicting the least recently used entry if the table is full.  Returns NULL if out of memory.
+nick_entry_t *nick_intern(nick_table_t *t, const char *nick);
+nick_entry_t *nick_lookup(nick_table_t *t, const char *nick);	// NULL if nick is not in the table
+nick_entry_t *nick_lookup_id(nick_table_t *t, unsigned int id);
+unsigned int nick_table_count(nick_table_t *t);
+unsigned long nick_table_memory(nick_table_t *t);
+
+#endif // CURSES_UI_NICKS_H
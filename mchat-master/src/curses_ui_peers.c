@@ -0,0 +1,27 @@
+#include <stdlib.h>
+#include <string.h>
+#include "curses_ui_peers.h"
+
+unsigned int peer_rows_from_mchat(mchat_t *mchat, peer_row_t **rows)
+{
+    *rows = NULL;
+    mchat_peerlist_t *pl;
+    if (!mchatv1_get_peerlist(mchat, &pl))
+        return 0;
+
+    unsigned int count = 0;
+    int size = mchatv1_peerlist_get_size(pl);
+    if (size > 0)
+        *rows = calloc(size, sizeof(peer_row_t));
+    for (int i = 0; *rows && i < size; i++)
+    {
+        peer_row_t *row = &(*rows)[count];
+        if (mchatv1_peer_get_peer(pl, i, row->nick, row->chan, MCHAT_LIMIT_MAX_NICKNAME_SIZE, MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE, &row->last_seen))
+            continue;
+        mchatv1_peer_get_source_address(pl, i, (unsigned char *)row->ip, sizeof(row->ip));
+        row->ip[sizeof(row->ip) - 1] = '\0';
+        count++;
+    }
+    mchatv1_peerlist_destroy(&pl);
+    return count;
+}
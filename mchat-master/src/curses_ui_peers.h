@@ -0,0 +1,21 @@
+#ifndef CURSES_UI_PEERS_H
+#define CURSES_UI_PEERS_H
+
+/*
+ * Snapshot of the libmchat peer list as plain rows, so it can be sorted, sent over the daemon socket
+ * and drawn without holding on to an mchat_peerlist_t.
+ */
+
+#include <mchatv1.h>
+
+typedef struct peer_row {
+    char nick[MCHAT_LIMIT_MAX_NICKNAME_SIZE];
+    char chan[MCHAT_LIMIT_MAX_CHANNEL_NAME_SIZE];
+    char ip[16];
+    long last_seen;		// microseconds since the epoch
+} peer_row_t;
+
+// Returns the number of rows stored in a malloc'd array at *rows (NULL when there are none)
+unsigned int peer_rows_from_mchat(mchat_t *mchat, peer_row_t **rows);
+
+#endif // CURSES_UI_PEERS_H
@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "curses_ui_reorder.h"
+
+typedef struct reorder_sender {
+    int known;
+    unsigned int next_seq;		// next sequence number to release
+    long long newest_usec;		// latest send time seen from this sender
+    unsigned int held;			// entries held for this sender
+} reorder_sender_t;
+
+typedef struct reorder_entry {
+    int used;
+    unsigned int sender;
+    unsigned int seq;
+    long long deadline_ms;
+    char *body;
+} reorder_entry_t;
+
+struct reorder {
+    unsigned int hold_ms;
+    unsigned int size;
+    reorder_entry_t *entries;		// size entries
+    unsigned int held;
+
+    reorder_sender_t *senders;		// indexed by sender id
+    unsigned int sender_cap;
+
+    reorder_deliver_function deliver;
+    void *arg;
+
+    unsigned long reordered;
+    unsigned long late;
+    unsigned long stale;
+};
+
+
+// Sequence numbers wrap, so compare them by their signed distance
+static int seq_diff(unsigned int a, unsigned int b)
+{
+    return (int)(a - b);
+}
+
+
+const char *reorder_parse(const char *body, reorder_stamp_t *stamp)
+{
+    if (body[0] != CURSES_UI_REORDER_MARK || body[1] != 'S')
+        return NULL;
+    int len = 0;
+    if (sscanf(body + 2, "%x.%llx%n", &stamp->seq, (unsigned long long *)&stamp->sent_usec, &len) != 2)
+        return NULL;
+    if (body[2 + len] != CURSES_UI_REORDER_MARK)
+        return NULL;
+    return body + 3 + len;
+}
+
+
+int reorder_format_stamp(char *buf, const reorder_stamp_t *stamp)
+{
+    return snprintf(buf, CURSES_UI_REORDER_STAMP_MAX, "%cS%x.%llx%c", CURSES_UI_REORDER_MARK, stamp->seq,
+        (unsigned long long)stamp->sent_usec, CURSES_UI_REORDER_MARK);
+}
+
+
+reorder_t *reorder_create(unsigned int hold_ms, unsigned int size, reorder_deliver_function deliver, void *arg)
+{
+    reorder_t *r = calloc(1, sizeof(reorder_t));
+    if (!r)
+        return NULL;
+    r->deliver = deliver;
+    r->arg = arg;
+    if (reorder_configure(r, hold_ms, size) != 0)
+    {
+        free(r);
+        return NULL;
+    }
+    return r;
+}
+
+
+void reorder_destroy(reorder_t **r)
+{
+    if (!r || !*r)
+        return;
+    for (unsigned int i = 0; i < (*r)->size; i++)
+        free((*r)->entries[i].body);
+    free((*r)->entries);
+    free((*r)->senders);
+    free(*r);
+    *r = NULL;
+}
+
+
+int reorder_configure(reorder_t *r, unsigned int hold_ms, unsigned int size)
+{
+    if (size == 0 || size > CURSES_UI_REORDER_MAX_SIZE)
+        return -1;
+    reorder_flush(r);
+    if (size != r->size)
+    {
+        reorder_entry_t *entries = calloc(size, sizeof(reorder_entry_t));
+        if (!entries)
+            return -1;
+        free(r->entries);
+        r->entries = entries;
+        r->size = size;
+    }
+    r->hold_ms = hold_ms;
+    return 0;
+}
+
+
+static reorder_sender_t *sender_get(reorder_t *r, unsigned int sender)
+{
+    if (sender >= r->sender_cap)
+    {
+        unsigned int cap = r->sender_cap ? r->sender_cap : 64;
+        while (cap <= sender)
+            cap *= 2;
+        reorder_sender_t *senders = realloc(r->senders, cap * sizeof(reorder_sender_t));
+        if (!senders)
+            return NULL;
+        memset(senders + r->sender_cap, 0, (cap - r->sender_cap) * sizeof(reorder_sender_t));
+        r->senders = senders;
+        r->sender_cap = cap;
+    }
+    return &r->senders[sender];
+}
+
+
+static void entry_release(reorder_t *r, reorder_sender_t *s, reorder_entry_t *e)
+{
+    r->deliver(r->arg, e->sender, e->body);
+    free(e->body);
+    e->body = NULL;
+    e->used = 0;
+    s->held--;
+    r->held--;
+}
+
+
+// Release held messages that continue the sender's sequence
+static void release_consecutive(reorder_t *r, unsigned int sender, reorder_sender_t *s)
+{
+    while (s->held)
+    {
+        reorder_entry_t *e = NULL;
+        for (unsigned int i = 0; i < r->size && !e; i++)
+        {
+            if (r->entries[i].used && r->entries[i].sender == sender && r->entries[i].seq == s->next_seq)
+                e = &r->entries[i];
+        }
+        if (!e)
+            return;
+        s->next_seq++;
+        entry_release(r, s, e);
+    }
+}
+
+
+// Give up on the sender's first gap: skip to the lowest held sequence number and release from there
+static void release_gap(reorder_t *r, unsigned int sender)
+{
+    reorder_sender_t *s = &r->senders[sender];
+    reorder_entry_t *lowest = NULL;
+    for (unsigned int i = 0; i < r->size; i++)
+    {
+        reorder_entry_t *e = &r->entries[i];
+        if (e->used && e->sender == sender && (!lowest || seq_diff(e->seq, lowest->seq) < 0))
+            lowest = e;
+    }
+    if (!lowest)
+        return;
+    s->next_seq = lowest->seq;
+    release_consecutive(r, sender, s);
+}
+
+
+void reorder_add(reorder_t *r, unsigned int sender, const reorder_stamp_t *stamp, const char *body, long long now_ms)
+{
+    unsigned int seq = stamp->seq;
+    reorder_sender_t *s = sender_get(r, sender);
+    if (!s)
+    {
+        r->deliver(r->arg, sender, body);
+        return;
+    }
+    if (!s->known)
+    {
+        s->known = 1;
+        s->next_seq = seq;
+        s->newest_usec = stamp->sent_usec;
+    }
+    long long newest_usec = s->newest_usec;
+    if (stamp->sent_usec > s->newest_usec)
+        s->newest_usec = stamp->sent_usec;
+
+    while (1)
+    {
+        int diff = seq_diff(seq, s->next_seq);
+        if (diff < -(int)r->size)
+        {
+            // Far behind and sent no later than what came before is a straggler whose place is long gone
+            if (stamp->sent_usec <= newest_usec)
+            {
+                r->stale++;
+                return;
+            }
+            // Sent after everything else - the sender restarted its count, so follow the new sequence
+            while (s->held)
+                release_gap(r, sender);
+            s->next_seq = seq;
+            diff = 0;
+        }
+        if (diff < 0)
+        {
+            r->late++;
+            r->deliver(r->arg, sender, body);
+            return;
+        }
+        if (diff == 0)
+        {
+            s->next_seq++;
+            r->deliver(r->arg, sender, body);
+            release_consecutive(r, sender, s);
+            return;
+        }
+        if (r->held < r->size)
+            break;
+
+        // Buffer full - release the sender holding the oldest message early to make room
+        reorder_entry_t *oldest = NULL;
+        for (unsigned int i = 0; i < r->size; i++)
+        {
+            if (r->entries[i].used && (!oldest || r->entries[i].deadline_ms < oldest->deadline_ms))
+                oldest = &r->entries[i];
+        }
+        release_gap(r, oldest->sender);
+    }
+
+    // Arrived ahead of a gap, hold it unless it is a duplicate
+    reorder_entry_t *slot = NULL;
+    for (unsigned int i = 0; i < r->size; i++)
+    {
+        reorder_entry_t *e = &r->entries[i];
+        if (e->used && e->sender == sender && e->seq == seq)
+            return;
+        if (!e->used && !slot)
+            slot = e;
+    }
+    if (!(slot->body = strdup(body)))
+    {
+        r->deliver(r->arg, sender, body);
+        return;
+    }
+    slot->used = 1;
+    slot->sender = sender;
+    slot->seq = seq;
+    slot->deadline_ms = now_ms + r->hold_ms;
+    s->held++;
+    r->held++;
+    r->reordered++;
+}
+
+
+int reorder_expire(reorder_t *r, long long now_ms)
+{
+    while (r->held)
+    {
+        reorder_entry_t *due = NULL;
+        long long next = -1;
+        for (unsigned int i = 0; i < r->size && !due; i++)
+        {
+            reorder_entry_t *e = &r->entries[i];
+            if (!e->used)
+                continue;
+            if (e->deadline_ms <= now_ms)
+                due = e;
+            else if (next < 0 || e->deadline_ms < next)
+                next = e->deadline_ms;
+        }
+        if (!due)
+            return next < 0 ? -1 : (int)(next - now_ms);
+        // Releasing a gap can free entries anywhere in the buffer, so look again afterwards
+        release_gap(r, due->sender);
+    }
+    return -1;
+}
+
+
+void reorder_flush(reorder_t *r)
+{
+    while (r->held)
+    {
+        for (unsigned int i = 0; i < r->size; i++)
+        {
+            if (r->entries[i].used)
+            {
+                release_gap(r, r->entries[i].sender);
+                break;
+            }
+        }
+    }
+}
+
+
+void reorder_forget(reorder_t *r, unsigned int sender)
+{
+    if (sender >= r->sender_cap)
+        return;
+    reorder_sender_t *s = &r->senders[sender];
+    for (unsigned int i = 0; i < r->size && s->held; i++)
+    {
+        reorder_entry_t *e = &r->entries[i];
+        if (e->used && e->sender == sender)
+        {
+            free(e->body);
+            e->body = NULL;
+            e->used = 0;
+            s->held--;
+            r->held--;
+        }
+    }
+    memset(s, 0, sizeof(reorder_sender_t));
+}
+
+
+unsigned int reorder_hold_ms(reorder_t *r)
+{
+    return r->hold_ms;
+}
+
+
+unsigned int reorder_size(reorder_t *r)
+{
+    return r->size;
+}
+
+
+unsigned int reorder_held(reorder_t *r)
+{
+    return r->held;
+}
+
+
+unsigned long reorder_reordered(reorder_t *r)
+{
+    return r->reordered;
+}
+
+
+unsigned long reorder_late(reorder_t *r)
+{
+    return r->late;
+}
+
+
+unsigned long reorder_stale(reorder_t *r)
+{
+    return r->stale;
+}
+
+
+unsigned long reorder_memory(reorder_t *r)
+{
+    unsigned long total = sizeof(reorder_t) + r->size * sizeof(reorder_entry_t) + r->sender_cap * sizeof(reorder_sender_t);
+    for (unsigned int i = 0; i < r->size; i++)
+    {
+        if (r->entries[i].used)
+            total += strlen(r->entries[i].body) + 1;
+    }
+    return total;
+}
@@ -0,0 +1,68 @@
+#ifndef CURSES_UI_REORDER_H
+#define CURSES_UI_REORDER_H
+
+/*
+ * Per-sender reordering of received messages.
+ *
+ * A sender can start every message with a small stamp: "\x1f" "S" <sequence, hex> "." <send time in usec, hex>
+ * "\x1f".  Clients without reordering display the stamp as part of the message, so sending stamps is off
+ * until \REORDER STAMP ON; receiving them is always understood.  Sequence numbers count up per sending
+ * client, so a receiver can tell when a sender's messages arrive out of order.  A message that arrives
+ * ahead of a gap is held for at most hold_ms while the missing ones catch up, and then released in
+ * sequence order whether or not the gap was filled.  At most size messages are held across all senders;
+ * when the buffer is full the oldest held message is released early.  Anything that shows up after its
+ * place in the sequence has been released is a late arrival and is delivered straight away.  A message
+ * more than size behind is either from a sender that restarted its count or a very old straggler; the send
+ * time tells them apart.  If it was sent after every earlier message from that sender, the sequence is
+ * picked up again from it, otherwise it is stale and dropped.  Unstamped messages are never held.
+ */
+
+#define CURSES_UI_REORDER_MARK '\x1f'
+#define CURSES_UI_REORDER_STAMP_MAX 32
+#define CURSES_UI_REORDER_HOLD_MS 50
+#define CURSES_UI_REORDER_SIZE 32
+#define CURSES_UI_REORDER_MAX_SIZE 1024
+
+typedef struct reorder_stamp {
+    unsigned int seq;
+    long long sent_usec;		// sender's CLOCK_REALTIME when the message was sent
+} reorder_stamp_t;
+
+typedef struct reorder reorder_t;
+
+// Called with every message released from the buffer, in sequence order per sender
+typedef void (*reorder_deliver_function)(void *arg, unsigned int sender, const char *body);
+
+// Parse a stamp.  Returns a pointer to the rest of the message, or NULL if body is not stamped.
+const char *reorder_parse(const char *body, reorder_stamp_t *stamp);
+
+// Write a stamp into buf (at least CURSES_UI_REORDER_STAMP_MAX bytes), returns its length
+int reorder_format_stamp(char *buf, const reorder_stamp_t *stamp);
+
+reorder_t *reorder_create(unsigned int hold_ms, unsigned int size, reorder_deliver_function deliver, void *arg);
+void reorder_destroy(reorder_t **r);
+
+// Release everything held, then change the hold time and buffer size
+int reorder_configure(reorder_t *r, unsigned int hold_ms, unsigned int size);
+
+// Add a stamped message from sender.  It is delivered immediately unless it arrived ahead of a gap or is stale.
+void reorder_add(reorder_t *r, unsigned int sender, const reorder_stamp_t *stamp, const char *body, long long now_ms);
+
+// Release messages whose hold time has run out.  Returns ms until the next one does, or -1 if none are held.
+int reorder_expire(reorder_t *r, long long now_ms);
+
+// Release everything held
+void reorder_flush(reorder_t *r);
+
+// Drop whatever is held for sender and forget its sequence, so the id can be reused for somebody else
+void reorder_forget(reorder_t *r, unsigned int sender);
+
+unsigned int reorder_hold_ms(reorder_t *r);
+unsigned int reorder_size(reorder_t *r);
+unsigned int reorder_held(reorder_t *r);
+unsigned long reorder_reordered(reorder_t *r);	// messages that arrived ahead of a gap and were held
+unsigned long reorder_late(reorder_t *r);	// messages that arrived after their place had been released
+unsigned long reorder_stale(reorder_t *r);	// messages dropped for being far behind without a newer send time
+unsigned long reorder_memory(reorder_t *r);	// bytes allocated, including held messages
+
+#endif // CURSES_UI_REORDER_H
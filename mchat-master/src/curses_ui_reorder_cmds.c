@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "curses_ui_internal.h"
+
+/* reorder commands implemented
+ * -reorder - configure the buffer that puts each sender's messages back in order
+ */
+
+
+// Returns 1 for a lone ON, 0 for a lone OFF and -1 for anything else
+static int parse_switch(char *str)
+{
+    char *rest;
+    if ((rest = match_keyword(str, "on")) && !rest[0])
+        return 1;
+    if ((rest = match_keyword(str, "off")) && !rest[0])
+        return 0;
+    return -1;
+}
+
+
+const char *reorder_string = "reorder";
+const char *reorder_syntax = "\\REORDER [ON|OFF|STAMP ON|STAMP OFF|HOLD_MS [SIZE]]";
+const char *reorder_help = "Show or configure how long out of order messages are held (SIZE is the most held at once), "
+    "STAMP sets whether our messages carry the sequence stamp other clients reorder by";
+int reorder_function(ui_state_t *state, char *str)
+{
+    char *ptr = str + strlen(reorder_string);
+    while (isspace(ptr[0])) ptr++;
+
+    if (ptr[0] == 0)
+    {
+        status_line_urg_set(1, "Reordering %s: hold %ums, size %u, %u held, %lu reordered, %lu late, %lu stale, "
+            "stamping %s", state->reorder_enabled ? "on" : "off", reorder_hold_ms(state->reorder),
+            reorder_size(state->reorder), reorder_held(state->reorder), reorder_reordered(state->reorder),
+            reorder_late(state->reorder), reorder_stale(state->reorder), state->stamp_outgoing ? "on" : "off");
+        return 0;
+    }
+
+    int enable = parse_switch(ptr);
+    if (enable >= 0)
+    {
+        ui_reorder_enable(enable);
+        status_line_urg_set(1, "Reordering %s", enable ? "on" : "off");
+        return 0;
+    }
+    char *arg = match_keyword(ptr, "stamp");
+    if (arg)
+    {
+        enable = parse_switch(arg);
+        if (enable < 0)
+        {
+            status_line_urg_set(1, "\\REORDER ERROR: STAMP takes ON or OFF");
+            return -1;
+        }
+        state->stamp_outgoing = enable;
+        status_line_urg_set(1, "Stamping sent messages %s", enable ? "on" : "off");
+        return 0;
+    }
+
+    char *end;
+    long hold_ms = strtol(ptr, &end, 10);
+    long size = reorder_size(state->reorder);
+    if (end == ptr || hold_ms < 0 || hold_ms > CURSES_UI_FRAG_TIMEOUT_MS)
+    {
+        status_line_urg_set(1, "\\REORDER ERROR: Invalid Argument");
+        return -1;
+    }
+    ptr = end;
+    while (isspace(ptr[0])) ptr++;
+    if (ptr[0])
+    {
+        size = strtol(ptr, &end, 10);
+        if (end == ptr || size < 1 || size > CURSES_UI_REORDER_MAX_SIZE)
+        {
+            status_line_urg_set(1, "\\REORDER ERROR: SIZE must be between 1 and %d", CURSES_UI_REORDER_MAX_SIZE);
+            return -1;
+        }
+    }
+
+    // Held messages are released before resizing, so nothing waits on the old timer
+    ui_reorder_enable(state->reorder_enabled);
+    if (reorder_configure(state->reorder, hold_ms, size) != 0)
+    {
+        status_line_urg_set(1, "\\REORDER ERROR: Could not resize the buffer");
+        return -1;
+    }
+    status_line_urg_set(1, "Holding out of order messages for up to %ldms, at most %ld at once", hold_ms, size);
+    return 0;
+}
+
+
+void load_reorder_cmds(ui_state_t *state)
+{
+    add_cmd(reorder_string, reorder_syntax, reorder_help, reorder_function);
+}
@@ -0,0 +1,320 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "curses_ui_sock.h"
+
+#define SOCK_READ_CHUNK 16384
+#define SOCK_IDLE_BUFFER 4096		// buffers are cut back to this once they drain
+
+
+static int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        return -1;
+    return 0;
+}
+
+
+static int unix_addr(const char *path, struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path))
+        return -1;
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+
+// Remove a stale socket left behind by a previous run.  Anything that is not a socket, or a socket
+// something is still listening on, is left alone and refused.
+static int remove_stale_socket(const char *path, const struct sockaddr_un *addr)
+{
+    struct stat st;
+    if (lstat(path, &st) != 0)
+        return errno == ENOENT ? 0 : -1;
+    if (!S_ISSOCK(st.st_mode))
+    {
+        errno = EEXIST;
+        return -1;
+    }
+
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0)
+        return -1;
+    int live = connect(probe, (const struct sockaddr *)addr, sizeof(*addr)) == 0;
+    close(probe);
+    if (live)
+    {
+        errno = EADDRINUSE;
+        return -1;
+    }
+    return unlink(path);
+}
+
+
+int sock_listen_unix(const char *path, mode_t mode)
+{
+    struct sockaddr_un addr;
+    if (unix_addr(path, &addr) != 0 || remove_stale_socket(path, &addr) != 0)
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    if (chmod(path, mode) < 0 || listen(fd, 64) < 0 || set_nonblocking(fd) < 0)
+    {
+        int err = errno;
+        close(fd);
+        unlink(path);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+
+int sock_connect_unix(const char *path)
+{
+    struct sockaddr_un addr;
+    if (unix_addr(path, &addr) != 0)
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || set_nonblocking(fd) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+int sock_accept(int listen_fd)
+{
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0)
+        return -1;
+    if (set_nonblocking(fd) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+sock_conn_t *sock_conn_create(int fd)
+{
+    sock_conn_t *c = calloc(1, sizeof(sock_conn_t));
+    if (c)
+        c->fd = fd;
+    return c;
+}
+
+
+void sock_conn_destroy(sock_conn_t **c)
+{
+    if (!c || !*c)
+        return;
+    if ((*c)->fd >= 0)
+        close((*c)->fd);
+    free((*c)->in);
+    free((*c)->out);
+    free(*c);
+    *c = NULL;
+}
+
+
+// Give back memory a burst of traffic left behind once the buffer is empty again
+static void shrink(char **buf, size_t *cap)
+{
+    if (*cap <= SOCK_IDLE_BUFFER)
+        return;
+    char *buf_new = realloc(*buf, SOCK_IDLE_BUFFER);
+    if (!buf_new)
+        return;
+    *buf = buf_new;
+    *cap = SOCK_IDLE_BUFFER;
+}
+
+
+static int reserve(char **buf, size_t *cap, size_t need)
+{
+    if (need <= *cap)
+        return 0;
+    if (need > CURSES_UI_SOCK_MAX_BUFFER)
+        return -1;
+    size_t cap_new = *cap ? *cap : 4096;
+    while (cap_new < need)
+        cap_new *= 2;
+    char *buf_new = realloc(*buf, cap_new);
+    if (!buf_new)
+        return -1;
+    *buf = buf_new;
+    *cap = cap_new;
+    return 0;
+}
+
+
+int sock_conn_read(sock_conn_t *c)
+{
+    // Drop frames that have already been parsed
+    if (c->in_pos)
+    {
+        memmove(c->in, c->in + c->in_pos, c->in_len - c->in_pos);
+        c->in_len -= c->in_pos;
+        c->in_pos = 0;
+    }
+
+    // A full buffer is left for the owner to parse; it only fails if it cannot hold a single frame
+    size_t room = CURSES_UI_SOCK_MAX_BUFFER - c->in_len;
+    if (room == 0)
+        return memchr(c->in, '\n', c->in_len) ? 0 : -1;
+
+    // Read onto the stack so the buffer only grows by what actually arrived
+    char chunk[SOCK_READ_CHUNK];
+    ssize_t got = read(c->fd, chunk, room < sizeof(chunk) ? room : sizeof(chunk));
+    if (got == 0)
+        return -1;
+    if (got < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    if (reserve(&c->in, &c->in_cap, c->in_len + got) != 0)
+        return -1;
+    memcpy(c->in + c->in_len, chunk, got);
+    c->in_len += got;
+    return (int)got;
+}
+
+
+static void unescape(char *field)
+{
+    char *out = field;
+    for (char *in = field; *in; in++)
+    {
+        if (*in == '\\' && in[1])
+        {
+            in++;
+            *out++ = *in == 't' ? '\t' : *in == 'n' ? '\n' : *in;
+        }
+        else
+            *out++ = *in;
+    }
+    *out = '\0';
+}
+
+
+int sock_conn_next_frame(sock_conn_t *c, char **fields, int max_fields)
+{
+    if (c->in_pos >= c->in_len)
+    {
+        // Everything parsed, and the caller is done with the previous frame's fields
+        c->in_pos = c->in_len = 0;
+        shrink(&c->in, &c->in_cap);
+        return 0;
+    }
+    char *start = c->in + c->in_pos;
+    char *end = memchr(start, '\n', c->in_len - c->in_pos);
+    if (!end)
+        return 0;
+    *end = '\0';
+    c->in_pos = end + 1 - c->in;
+
+    int count = 0;
+    char *field = start;
+    while (count < max_fields)
+    {
+        char *tab = strchr(field, '\t');
+        if (tab && count < max_fields - 1)
+            *tab = '\0';
+        else
+            tab = NULL;
+        unescape(field);
+        fields[count++] = field;
+        if (!tab)
+            break;
+        field = tab + 1;
+    }
+    return count;
+}
+
+
+static int queue_field(sock_conn_t *c, const char *field, int first)
+{
+    size_t len = strlen(field);
+    // Worst case every byte is escaped, plus the separator
+    if (reserve(&c->out, &c->out_cap, c->out_len + len * 2 + 2) != 0)
+        return -1;
+    if (!first)
+        c->out[c->out_len++] = '\t';
+    for (const char *p = field; *p; p++)
+    {
+        if (*p == '\\' || *p == '\t' || *p == '\n')
+        {
+            c->out[c->out_len++] = '\\';
+            c->out[c->out_len++] = *p == '\t' ? 't' : *p == '\n' ? 'n' : '\\';
+        }
+        else
+            c->out[c->out_len++] = *p;
+    }
+    return 0;
+}
+
+
+int sock_conn_queue(sock_conn_t *c, const char *type, ...)
+{
+    size_t rollback = c->out_len;
+    int ret = queue_field(c, type, 1);
+
+    va_list args;
+    va_start(args, type);
+    const char *field;
+    while (ret == 0 && (field = va_arg(args, const char *)) != NULL)
+        ret = queue_field(c, field, 0);
+    va_end(args);
+
+    if (ret == 0 && reserve(&c->out, &c->out_cap, c->out_len + 1) == 0)
+    {
+        c->out[c->out_len++] = '\n';
+        return 0;
+    }
+    c->out_len = rollback;
+    c->overflow = 1;
+    return -1;
+}
+
+
+int sock_conn_flush(sock_conn_t *c)
+{
+    if (c->out_len == 0)
+        return 0;
+    ssize_t sent = send(c->fd, c->out, c->out_len, MSG_NOSIGNAL);
+    if (sent < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    memmove(c->out, c->out + sent, c->out_len - sent);
+    c->out_len -= sent;
+    if (c->out_len == 0)
+        shrink(&c->out, &c->out_cap);
+    return 0;
+}
+
+
+unsigned long sock_conn_memory(sock_conn_t *c)
+{
+    return sizeof(sock_conn_t) + c->in_cap + c->out_cap;
+}
@@ -0,0 +1,59 @@
+#ifndef CURSES_UI_SOCK_H
+#define CURSES_UI_SOCK_H
+
+/*
+ * Non-blocking Unix domain socket helpers shared by the daemon and control socket.
+ *
+ * Frames are single lines of tab separated fields terminated by a newline.  The first field is the
+ * frame type.  Backslash, tab and newline inside a field are escaped as \\, \t and \n, so message
+ * bodies can carry any text.  Each connection buffers input and output: sock_conn_read() and
+ * sock_conn_flush() each issue at most one system call, so a whole batch of frames is moved per call.
+ * Both buffers grow with a burst of traffic and are cut back once they have drained.
+ */
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define CURSES_UI_SOCK_MAX_FIELDS 8
+#define CURSES_UI_SOCK_MAX_BUFFER (4 * 1024 * 1024)	// per direction, per connection
+
+typedef struct sock_conn {
+    int fd;
+    char *in;
+    size_t in_len;
+    size_t in_pos;		// start of the next unparsed frame
+    size_t in_cap;
+    char *out;
+    size_t out_len;
+    size_t out_cap;
+    int overflow;		// a frame could not be queued, the owner should drop the connection
+} sock_conn_t;
+
+// All of these return -1 on error (with errno set)
+// sock_listen_unix only replaces a stale socket at path: any other file gives EEXIST, a live socket EADDRINUSE.
+// The socket file gets exactly mode (not filtered by the umask), which decides who may connect.
+int sock_listen_unix(const char *path, mode_t mode);
+int sock_connect_unix(const char *path);
+int sock_accept(int listen_fd);
+
+sock_conn_t *sock_conn_create(int fd);
+void sock_conn_destroy(sock_conn_t **c);
+
+// Read what is available, up to CURSES_UI_SOCK_MAX_BUFFER buffered.  Returns the number of bytes read, 0 if
+// nothing was available or the buffer is full (parse frames, then read again), or -1 when the peer has gone
+// away or sent a frame larger than the buffer.
+int sock_conn_read(sock_conn_t *c);
+
+// Parse the next complete frame in place.  Returns the number of fields, or 0 if no complete frame is buffered.
+int sock_conn_next_frame(sock_conn_t *c, char **fields, int max_fields);
+
+// Queue a frame made of a NULL terminated list of fields.  Returns -1 and sets overflow if the output buffer is full.
+int sock_conn_queue(sock_conn_t *c, const char *type, ...);
+
+// Write as much queued output as the socket accepts.  Returns -1 when the peer has gone away.
+int sock_conn_flush(sock_conn_t *c);
+
+// Bytes allocated for the connection and its buffers
+unsigned long sock_conn_memory(sock_conn_t *c);
+
+#endif // CURSES_UI_SOCK_H
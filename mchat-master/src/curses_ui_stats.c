@@ -0,0 +1,44 @@
+#include "curses_ui_stats.h"
+
+// Weight of a new sample in the rate and skew averages (jitter uses 1/16 as in RFC 3550)
+#define PEER_STATS_GAIN (1.0 / 8)
+#define PEER_STATS_JITTER_GAIN (1.0 / 16)
+
+
+void peer_stats_update(peer_stats_t *st, long long recv_usec, long long sent_usec)
+{
+    if (st->count > 0)
+    {
+        double interval = recv_usec - st->last_recv_usec;
+        if (interval < 0)
+            interval = 0;
+        if (st->count == 1)
+            st->interval_usec = interval;
+        else
+            st->interval_usec += (interval - st->interval_usec) * PEER_STATS_GAIN;
+    }
+    st->count++;
+    st->last_recv_usec = recv_usec;
+
+    if (sent_usec < 0)
+        return;
+    double transit = recv_usec - sent_usec;
+    if (st->stamped == 0)
+        st->skew_usec = transit;
+    else
+    {
+        double change = transit > st->transit_usec ? transit - st->transit_usec : st->transit_usec - transit;
+        st->jitter_usec += (change - st->jitter_usec) * PEER_STATS_JITTER_GAIN;
+        st->skew_usec += (transit - st->skew_usec) * PEER_STATS_GAIN;
+    }
+    st->transit_usec = transit;
+    st->stamped++;
+}
+
+
+double peer_stats_rate(const peer_stats_t *st)
+{
+    if (st->count < 2 || st->interval_usec <= 0)
+        return 0;
+    return 1000000.0 / st->interval_usec;
+}
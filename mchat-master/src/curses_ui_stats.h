@@ -0,0 +1,30 @@
+#ifndef CURSES_UI_STATS_H
+#define CURSES_UI_STATS_H
+
+/*
+ * Streaming per-peer traffic statistics.
+ *
+ * Everything is kept as exponentially weighted moving averages, so each peer costs a fixed handful of
+ * fields no matter how long the session runs.  The inter-arrival time gives the message rate.  For
+ * stamped messages (see curses_ui_reorder.h) the transit time is our receive time minus the sender's send
+ * time: its average is the estimated clock skew (plus one-way network delay, which is small next to skew
+ * on a LAN) and its variation between messages is the jitter, computed as in RFC 3550.
+ */
+
+typedef struct peer_stats {
+    unsigned long count;		// messages received
+    unsigned long stamped;		// messages that carried a send time
+    long long last_recv_usec;
+    double interval_usec;		// average time between messages
+    double transit_usec;		// transit time of the last stamped message
+    double jitter_usec;			// average change in transit time between stamped messages
+    double skew_usec;			// average transit time, positive when the sender's clock is behind ours
+} peer_stats_t;
+
+// Account for a message received at recv_usec, sent at sent_usec (negative if unknown), both CLOCK_REALTIME
+void peer_stats_update(peer_stats_t *st, long long recv_usec, long long sent_usec);
+
+// Messages per second, 0 until two messages have arrived
+double peer_stats_rate(const peer_stats_t *st);
+
+#endif // CURSES_UI_STATS_H
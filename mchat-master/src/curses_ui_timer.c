@@ -0,0 +1,224 @@
+#include <stdlib.h>
+#include "curses_ui_timer.h"
+
+#define SLOT_MASK (CURSES_UI_TIMER_SLOTS - 1)
+#define MAX_DELTA ((1ULL << (CURSES_UI_TIMER_BITS * CURSES_UI_TIMER_LEVELS)) - 1)
+
+struct ui_timer {
+    ui_timer_t *prev;
+    ui_timer_t *next;
+    ui_timer_t **head;			// slot list this timer is on
+    unsigned long long expires;		// tick this timer fires on
+    unsigned long long period;		// in ticks, 0 for one-shot timers
+    timer_function func;
+    void *arg;
+    int cancelled;			// cancelled from inside its own callback
+};
+
+struct timer_wheel {
+    struct ui_state *state;
+    long long base_ms;			// wall time of tick 0
+    unsigned long long tick;		// next tick to process
+    unsigned int count;
+    ui_timer_t *running;		// timer whose callback is executing
+    ui_timer_t *slots[CURSES_UI_TIMER_LEVELS][CURSES_UI_TIMER_SLOTS];
+};
+
+
+static void link_timer(timer_wheel_t *w, ui_timer_t *t)
+{
+    unsigned long long delta = t->expires > w->tick ? t->expires - w->tick : 0;
+    if (delta > MAX_DELTA)
+    {
+        // Park it in the furthest slot, it is re-filed when that slot cascades
+        delta = MAX_DELTA;
+    }
+
+    int level = 0;
+    while (level < CURSES_UI_TIMER_LEVELS - 1 && delta >= (1ULL << (CURSES_UI_TIMER_BITS * (level + 1))))
+        level++;
+    unsigned long long when = w->tick + delta;
+    ui_timer_t **head = &w->slots[level][(when >> (CURSES_UI_TIMER_BITS * level)) & SLOT_MASK];
+
+    t->head = head;
+    t->prev = NULL;
+    t->next = *head;
+    if (*head)
+        (*head)->prev = t;
+    *head = t;
+}
+
+
+static void unlink_timer(ui_timer_t *t)
+{
+    if (t->prev)
+        t->prev->next = t->next;
+    else
+        *t->head = t->next;
+    if (t->next)
+        t->next->prev = t->prev;
+    t->prev = t->next = NULL;
+    t->head = NULL;
+}
+
+
+timer_wheel_t *timer_wheel_create(struct ui_state *s, long long now_ms)
+{
+    timer_wheel_t *w = calloc(1, sizeof(timer_wheel_t));
+    if (!w)
+        return NULL;
+    w->state = s;
+    w->base_ms = now_ms;
+    return w;
+}
+
+
+void timer_wheel_destroy(timer_wheel_t **w)
+{
+    if (!w || !*w)
+        return;
+    for (int level = 0; level < CURSES_UI_TIMER_LEVELS; level++)
+    {
+        for (int slot = 0; slot < CURSES_UI_TIMER_SLOTS; slot++)
+        {
+            ui_timer_t *t = (*w)->slots[level][slot];
+            while (t)
+            {
+                ui_timer_t *next = t->next;
+                free(t);
+                t = next;
+            }
+        }
+    }
+    free(*w);
+    *w = NULL;
+}
+
+
+ui_timer_t *timer_add(timer_wheel_t *w, unsigned int delay_ms, unsigned int period_ms, timer_function func, void *arg)
+{
+    ui_timer_t *t = calloc(1, sizeof(ui_timer_t));
+    if (!t)
+        return NULL;
+    t->expires = w->tick + (delay_ms + CURSES_UI_TIMER_TICK_MS - 1) / CURSES_UI_TIMER_TICK_MS;
+    // Timers added from a callback never fire in the tick being processed
+    if (w->running && t->expires <= w->tick)
+        t->expires = w->tick + 1;
+    t->period = (period_ms + CURSES_UI_TIMER_TICK_MS - 1) / CURSES_UI_TIMER_TICK_MS;
+    if (period_ms && t->period == 0)
+        t->period = 1;
+    t->func = func;
+    t->arg = arg;
+    link_timer(w, t);
+    w->count++;
+    return t;
+}
+
+
+void timer_cancel(timer_wheel_t *w, ui_timer_t *t)
+{
+    if (!t)
+        return;
+    if (t == w->running)
+    {
+        t->cancelled = 1;
+        return;
+    }
+    unlink_timer(t);
+    free(t);
+    w->count--;
+}
+
+
+// Move every timer in a higher level slot down to where it now belongs
+static void cascade(timer_wheel_t *w, int level)
+{
+    ui_timer_t **head = &w->slots[level][(w->tick >> (CURSES_UI_TIMER_BITS * level)) & SLOT_MASK];
+    ui_timer_t *t = *head;
+    *head = NULL;
+    while (t)
+    {
+        ui_timer_t *next = t->next;
+        link_timer(w, t);
+        t = next;
+    }
+}
+
+
+void timer_wheel_run(timer_wheel_t *w, long long now_ms)
+{
+    unsigned long long now_tick = (now_ms - w->base_ms) / CURSES_UI_TIMER_TICK_MS;
+    while (w->tick <= now_tick)
+    {
+        for (int level = 1; level < CURSES_UI_TIMER_LEVELS; level++)
+        {
+            if ((w->tick & ((1ULL << (CURSES_UI_TIMER_BITS * level)) - 1)) != 0)
+                break;
+            cascade(w, level);
+        }
+
+        ui_timer_t **head = &w->slots[0][w->tick & SLOT_MASK];
+        while (*head)
+        {
+            ui_timer_t *t = *head;
+            unlink_timer(t);
+            if (t->expires > w->tick)
+            {
+                // Parked beyond the wheel's range - file it again
+                link_timer(w, t);
+                continue;
+            }
+
+            w->running = t;
+            int ret = t->func(w->state, t->arg);
+            w->running = NULL;
+            if (ret == 0 && t->period && !t->cancelled)
+            {
+                t->expires = w->tick + t->period;
+                link_timer(w, t);
+            }
+            else
+            {
+                free(t);
+                w->count--;
+            }
+        }
+        w->tick++;
+    }
+}
+
+
+int timer_wheel_next_timeout(timer_wheel_t *w, long long now_ms, int max_ms)
+{
+    long long next_ms = w->base_ms + (long long)w->tick * CURSES_UI_TIMER_TICK_MS;
+    if (next_ms <= now_ms)
+        next_ms = now_ms;
+
+    // Only the bottom wheel is searched.  Anything further out is at least a wrap away, and the
+    // cascade at the wrap is treated as a deadline so the wait never overshoots a timer.
+    int slot;
+    for (slot = 0; slot < CURSES_UI_TIMER_SLOTS; slot++)
+    {
+        if (slot > 0 && ((w->tick + slot) & SLOT_MASK) == 0)
+            break;
+        if (w->slots[0][(w->tick + slot) & SLOT_MASK])
+            break;
+    }
+
+    long long wait = next_ms + (long long)slot * CURSES_UI_TIMER_TICK_MS - now_ms;
+    if (wait > max_ms)
+        wait = max_ms;
+    return wait < 0 ? 0 : (int)wait;
+}
+
+
+unsigned int timer_wheel_count(timer_wheel_t *w)
+{
+    return w->count;
+}
+
+
+unsigned long timer_wheel_memory(timer_wheel_t *w)
+{
+    return sizeof(timer_wheel_t) + w->count * sizeof(ui_timer_t);
+}
@@ -0,0 +1,44 @@
+#ifndef CURSES_UI_TIMER_H
+#define CURSES_UI_TIMER_H
+
+/*
+ * Hierarchical timer wheel used to schedule main-loop runnables.
+ *
+ * Time is divided into CURSES_UI_TIMER_TICK_MS ticks.  Timers live in one of CURSES_UI_TIMER_LEVELS
+ * wheels of CURSES_UI_TIMER_SLOTS slots each, chosen by how far in the future they expire, and are
+ * cascaded down a level as the lower wheel wraps.  Adding and cancelling a timer is O(1), and nothing
+ * is done for a timer between the time it is added and the time it fires apart from the occasional
+ * cascade.
+ *
+ * Timer callbacks return 0 to keep a periodic timer running and non-zero to cancel it.  A timer handle
+ * is invalid once it has been cancelled or once a one-shot timer has fired.
+ */
+
+#define CURSES_UI_TIMER_TICK_MS 10
+#define CURSES_UI_TIMER_BITS 6
+#define CURSES_UI_TIMER_SLOTS (1 << CURSES_UI_TIMER_BITS)
+#define CURSES_UI_TIMER_LEVELS 4
+
+struct ui_state;
+typedef int (*timer_function)(struct ui_state *s, void *arg);
+
+typedef struct timer_wheel timer_wheel_t;
+typedef struct ui_timer ui_timer_t;
+
+timer_wheel_t *timer_wheel_create(struct ui_state *s, long long now_ms);
+void timer_wheel_destroy(timer_wheel_t **w);
+
+// Run func after delay_ms, then every period_ms if period_ms is non-zero
+ui_timer_t *timer_add(timer_wheel_t *w, unsigned int delay_ms, unsigned int period_ms, timer_function func, void *arg);
+void timer_cancel(timer_wheel_t *w, ui_timer_t *t);
+
+// Fire every timer that has expired by now_ms
+void timer_wheel_run(timer_wheel_t *w, long long now_ms);
+
+// Milliseconds until the next timer may fire, capped at max_ms
+int timer_wheel_next_timeout(timer_wheel_t *w, long long now_ms, int max_ms);
+
+unsigned int timer_wheel_count(timer_wheel_t *w);
+unsigned long timer_wheel_memory(timer_wheel_t *w);
+
+#endif // CURSES_UI_TIMER_H
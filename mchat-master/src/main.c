@@ -1,9 +1,72 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "curses_ui.h"
 
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-c CAPTURE_FILE] [-r REPLAY_FILE [-s SPEED|max]] [-A SOCKET] [-C CONTROL_SOCKET]\n", prog);
+	fprintf(stderr, "       %s -D SOCKET\n", prog);
+}
+
 int main(int argc, char *argv[])
 {
-	ui_init(NULL);
+	char *capture_path = NULL;
+	char *replay_path = NULL;
+	char *daemon_path = NULL;
+	char *attach_path = NULL;
+	char *control_path = NULL;
+	double replay_speed = 1.0;
+	int opt;
+	while ((opt = getopt(argc, argv, "c:r:s:D:A:C:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'c':
+			capture_path = optarg;
+			break;
+		case 'r':
+			replay_path = optarg;
+			break;
+		case 's':
+			if (strcmp(optarg, "max") == 0)
+				replay_speed = 0;
+			else if ((replay_speed = atof(optarg)) <= 0)
+			{
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'D':
+			daemon_path = optarg;
+			break;
+		case 'A':
+			attach_path = optarg;
+			break;
+		case 'C':
+			control_path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	// Shared daemon: no ui at all, just the mchat endpoint and the client socket
+	if (daemon_path)
+		return ui_daemon_run(daemon_path) == 0 ? 0 : 1;
+
+	if (attach_path)
+		ui_init_attached(NULL, attach_path);
+	else
+		ui_init(NULL);
+	if (capture_path)
+		ui_capture_start(capture_path);
+	if (replay_path)
+		ui_replay_start(replay_path, replay_speed);
+	if (control_path)
+		ui_control_start(control_path);
 	ui_run();
 	ui_destroy();
 	return 0;
@@ -0,0 +1,24 @@
+#ifndef CURSES_UI_TEST_H
+#define CURSES_UI_TEST_H
+
+/*
+ * Minimal checks for the unit tests.  Each test is its own executable registered with CTest; a failed
+ * CHECK prints where it failed and the test exits non-zero once main() returns TEST_RESULT.
+ */
+
+#include <stdio.h>
+
+static int test_failures;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define TEST_RESULT (test_failures ? 1 : 0)
+
+#endif // CURSES_UI_TEST_H
@@ -0,0 +1,135 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "curses_ui_capture.h"
+#include "test.h"
+
+
+static void write_file(const char *path, const void *data, size_t len)
+{
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        return;
+    fwrite(data, 1, len, fp);
+    fclose(fp);
+}
+
+
+static void test_round_trip(const char *path)
+{
+    capture_t *c = capture_open_write(path);
+    CHECK(c != NULL);
+    if (!c)
+        return;
+    CHECK(capture_write(c, 1000001, 0, "alice", "10.0.0.1", "first") == 0);
+    CHECK(capture_write(c, 1000002, 3, "bob", "", "tabs\tand\nnewlines") == 0);
+    CHECK(capture_write(c, 1792354999123456LL, 0, "alice", "10.0.0.1", "") == 0);
+    CHECK(capture_flush(c) == 0);
+    capture_close(&c);
+    CHECK(c == NULL);
+
+    capture_record_t rec;
+    c = capture_open_read(path);
+    CHECK(c != NULL);
+    if (!c)
+        return;
+    CHECK(capture_read(c, &rec) == 1);
+    CHECK(rec.usec == 1000001 && strcmp(rec.nick, "alice") == 0);
+    CHECK(strcmp(rec.source, "10.0.0.1") == 0 && strcmp(rec.body, "first") == 0);
+    CHECK(capture_read(c, &rec) == 1);
+    CHECK(rec.usec == 1000002 && strcmp(rec.nick, "bob") == 0);
+    CHECK(rec.source[0] == '\0' && strcmp(rec.body, "tabs\tand\nnewlines") == 0);
+    CHECK(capture_read(c, &rec) == 1);
+    CHECK(rec.usec == 1792354999123456LL && strcmp(rec.nick, "alice") == 0 && rec.body[0] == '\0');
+    CHECK(capture_read(c, &rec) == 0);
+    capture_close(&c);
+}
+
+
+// An id given to another nickname is defined again before its next message
+static void test_reused_id(const char *path)
+{
+    capture_t *c = capture_open_write(path);
+    CHECK(c != NULL);
+    if (!c)
+        return;
+    unsigned long empty = capture_memory(c);
+    CHECK(capture_write(c, 1, 7, "alice", "", "one") == 0);
+    CHECK(capture_memory(c) > empty);
+    capture_forget_nick(c, 7);
+    capture_forget_nick(c, 100000);
+    CHECK(capture_write(c, 2, 7, "bob", "", "two") == 0);
+    capture_close(&c);
+
+    capture_record_t rec;
+    c = capture_open_read(path);
+    CHECK(c != NULL);
+    if (!c)
+        return;
+    CHECK(capture_read(c, &rec) == 1 && strcmp(rec.nick, "alice") == 0);
+    CHECK(capture_read(c, &rec) == 1 && strcmp(rec.nick, "bob") == 0 && strcmp(rec.body, "two") == 0);
+    CHECK(capture_read(c, &rec) == 0);
+    capture_close(&c);
+}
+
+
+static void test_malformed(const char *path)
+{
+    capture_record_t rec;
+
+    write_file(path, "NOPE\x02", 5);
+    CHECK(capture_open_read(path) == NULL);
+
+    // Right magic, wrong version
+    write_file(path, "MCAP\x7f", 5);
+    CHECK(capture_open_read(path) == NULL);
+
+    // A message referring to a nickname that was never defined
+    static const unsigned char undefined_nick[] = {
+        'M', 'C', 'A', 'P', CURSES_UI_CAPTURE_VERSION,
+        'M', 1, 0, 0, 0, 0, 0, 0, 0, 9, 0, 0, 0, 0, 0, 1, 0, 0, 0, 'x'
+    };
+    write_file(path, undefined_nick, sizeof(undefined_nick));
+    capture_t *c = capture_open_read(path);
+    CHECK(c != NULL);
+    if (c)
+    {
+        CHECK(capture_read(c, &rec) == -1);
+        capture_close(&c);
+    }
+
+    // A record cut short
+    static const unsigned char truncated[] = {
+        'M', 'C', 'A', 'P', CURSES_UI_CAPTURE_VERSION,
+        'N', 0, 0, 0, 0, 5, 0, 'a', 'l', 'i', 'c', 'e',
+        'M', 1, 0, 0
+    };
+    write_file(path, truncated, sizeof(truncated));
+    c = capture_open_read(path);
+    CHECK(c != NULL);
+    if (c)
+    {
+        CHECK(capture_read(c, &rec) == -1);
+        capture_close(&c);
+    }
+}
+
+
+int main()
+{
+    char path[] = "/tmp/curses_ui_test_capture_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    test_round_trip(path);
+    test_reused_id(path);
+    test_malformed(path);
+    unlink(path);
+    return TEST_RESULT;
+}
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <string.h>
+#include "curses_ui_channels.h"
+#include "test.h"
+
+
+static const channel_entry_t *find(channel_dir_t *d, const char *name)
+{
+    for (unsigned int i = 0; i < channel_dir_count(d); i++)
+    {
+        const channel_entry_t *e = channel_dir_get(d, i);
+        if (strcmp(e->name, name) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+
+static void test_scan()
+{
+    channel_dir_t *d = channel_dir_create();
+    unsigned long version = channel_dir_version(d);
+    channel_dir_begin_scan(d);
+    channel_dir_add_peer(d, "#mchat", 100, 0);
+    channel_dir_add_peer(d, "#mchat", 300, 0);
+    channel_dir_add_peer(d, "#ops", 200, 0);
+    channel_dir_add_peer(d, "", 400, 0);	// peers on no channel are not listed
+    channel_dir_end_scan(d, 0);
+    CHECK(channel_dir_count(d) == 2);
+    CHECK(channel_dir_version(d) != version);
+
+    const channel_entry_t *e = find(d, "#mchat");
+    CHECK(e && e->members == 2 && e->last_seen == 300);
+    e = find(d, "#ops");
+    CHECK(e && e->members == 1 && e->last_seen == 200);
+    CHECK(channel_dir_get(d, 2) == NULL);
+
+    // The same peers again change nothing, so views have nothing to redraw
+    version = channel_dir_version(d);
+    channel_dir_begin_scan(d);
+    channel_dir_add_peer(d, "#mchat", 100, 1000);
+    channel_dir_add_peer(d, "#mchat", 300, 1000);
+    channel_dir_add_peer(d, "#ops", 200, 1000);
+    channel_dir_end_scan(d, 1000);
+    CHECK(channel_dir_version(d) == version);
+
+    // A peer leaving updates the member count
+    channel_dir_begin_scan(d);
+    channel_dir_add_peer(d, "#mchat", 300, 2000);
+    channel_dir_add_peer(d, "#ops", 200, 2000);
+    channel_dir_end_scan(d, 2000);
+    CHECK(channel_dir_version(d) != version);
+    e = find(d, "#mchat");
+    CHECK(e && e->members == 1);
+    CHECK(channel_dir_memory(d) > 0);
+    channel_dir_destroy(&d);
+    CHECK(d == NULL);
+}
+
+
+static void test_expiry()
+{
+    channel_dir_t *d = channel_dir_create();
+    channel_dir_begin_scan(d);
+    channel_dir_add_peer(d, "#old", 100, 0);
+    channel_dir_add_peer(d, "#new", 100, 0);
+    channel_dir_end_scan(d, 0);
+
+    // #old stops being reported and is dropped once it has not been seen for the expiry time
+    channel_dir_begin_scan(d);
+    channel_dir_add_peer(d, "#new", 100, CURSES_UI_CHANNEL_EXPIRE_MS - 1);
+    channel_dir_end_scan(d, CURSES_UI_CHANNEL_EXPIRE_MS - 1);
+    CHECK(channel_dir_count(d) == 2);
+    const channel_entry_t *e = find(d, "#old");
+    CHECK(e && e->members == 0);
+    channel_dir_begin_scan(d);
+    channel_dir_add_peer(d, "#new", 100, CURSES_UI_CHANNEL_EXPIRE_MS);
+    channel_dir_end_scan(d, CURSES_UI_CHANNEL_EXPIRE_MS);
+    CHECK(channel_dir_count(d) == 1);
+    CHECK(find(d, "#old") == NULL && find(d, "#new") != NULL);
+
+    // The compacted directory still finds its entries
+    channel_dir_begin_scan(d);
+    channel_dir_add_peer(d, "#new", 100, CURSES_UI_CHANNEL_EXPIRE_MS + 1);
+    channel_dir_end_scan(d, CURSES_UI_CHANNEL_EXPIRE_MS + 1);
+    CHECK(channel_dir_count(d) == 1);
+    channel_dir_destroy(&d);
+}
+
+
+static void test_many()
+{
+    channel_dir_t *d = channel_dir_create();
+    char name[32];
+    channel_dir_begin_scan(d);
+    for (unsigned int i = 0; i < CURSES_UI_MAX_CHANNELS + 10; i++)
+    {
+        snprintf(name, sizeof(name), "#c%u", i);
+        channel_dir_add_peer(d, name, i, 0);
+    }
+    channel_dir_end_scan(d, 0);
+    CHECK(channel_dir_count(d) == CURSES_UI_MAX_CHANNELS);
+    const channel_entry_t *e = find(d, "#c4000");
+    CHECK(e && e->members == 1 && e->last_seen == 4000);
+    channel_dir_destroy(&d);
+}
+
+
+int main()
+{
+    test_scan();
+    test_expiry();
+    test_many();
+    return TEST_RESULT;
+}
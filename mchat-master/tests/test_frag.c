@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+#include "curses_ui_frag.h"
+#include "test.h"
+
+
+static void test_header()
+{
+    char buf[CURSES_UI_FRAG_HEADER_MAX + 8];
+    frag_header_t hdr = { 0xbeef, 2, 5 }, parsed;
+    int len = frag_format_header(buf, &hdr);
+    CHECK(len > 0 && len < CURSES_UI_FRAG_HEADER_MAX);
+    strcpy(buf + len, "payload");
+
+    const char *payload = frag_parse(buf, &parsed);
+    CHECK(payload && strcmp(payload, "payload") == 0);
+    CHECK(parsed.seq == 0xbeef && parsed.index == 2 && parsed.count == 5);
+
+    // Ordinary messages and broken or impossible headers are not fragments
+    CHECK(frag_parse("hello", &parsed) == NULL);
+    CHECK(frag_parse("\x1f" "F1.0.2", &parsed) == NULL);
+    CHECK(frag_parse("\x1f" "F1.2.2\x1f" "x", &parsed) == NULL);
+    CHECK(frag_parse("\x1f" "F1.0.0\x1f" "x", &parsed) == NULL);
+}
+
+
+static void test_reassembly()
+{
+    frag_table_t *t = frag_table_create();
+    frag_header_t hdr = { 7, 0, 3 };
+    static const char *parts[3] = { "one ", "two ", "three" };
+
+    // Fragments may arrive in any order, and duplicates are ignored
+    hdr.index = 2;
+    CHECK(frag_add(t, 1, &hdr, parts[2], 0) == NULL);
+    hdr.index = 0;
+    CHECK(frag_add(t, 1, &hdr, parts[0], 1) == NULL);
+    CHECK(frag_add(t, 1, &hdr, parts[0], 2) == NULL);
+    hdr.index = 1;
+    char *message = frag_add(t, 1, &hdr, parts[1], 3);
+    CHECK(message && strcmp(message, "one two three") == 0);
+    free(message);
+    CHECK(frag_completed(t) == 1);
+    CHECK(frag_dropped(t) == 0);
+    frag_table_destroy(&t);
+    CHECK(t == NULL);
+}
+
+
+static void test_interleaved_senders()
+{
+    frag_table_t *t = frag_table_create();
+    frag_header_t a = { 1, 0, 2 }, b = { 1, 0, 2 };
+    CHECK(frag_add(t, 10, &a, "a0", 0) == NULL);
+    CHECK(frag_add(t, 11, &b, "b0", 0) == NULL);
+    a.index = b.index = 1;
+    char *mb = frag_add(t, 11, &b, "b1", 0);
+    char *ma = frag_add(t, 10, &a, "a1", 0);
+    CHECK(ma && strcmp(ma, "a0a1") == 0);
+    CHECK(mb && strcmp(mb, "b0b1") == 0);
+    free(ma);
+    free(mb);
+    frag_table_destroy(&t);
+}
+
+
+static void test_drops()
+{
+    frag_table_t *t = frag_table_create();
+    frag_header_t hdr = { 1, 0, 2 };
+    unsigned long empty = frag_table_memory(t);
+
+    // An incomplete message times out
+    CHECK(frag_add(t, 1, &hdr, "stale", 0) == NULL);
+    CHECK(frag_table_memory(t) > empty);
+    frag_expire(t, CURSES_UI_FRAG_TIMEOUT_MS - 1);
+    CHECK(frag_dropped(t) == 0);
+    frag_expire(t, CURSES_UI_FRAG_TIMEOUT_MS);
+    CHECK(frag_dropped(t) == 1);
+    CHECK(frag_table_memory(t) == empty);
+
+    // A sender starting a new message abandons the one in progress
+    CHECK(frag_add(t, 1, &hdr, "old", 0) == NULL);
+    hdr.seq = 2;
+    CHECK(frag_add(t, 1, &hdr, "new", 0) == NULL);
+    CHECK(frag_dropped(t) == 2);
+    hdr.index = 1;
+    char *message = frag_add(t, 1, &hdr, "er", 0);
+    CHECK(message && strcmp(message, "newer") == 0);
+    free(message);
+
+    // With every slot busy the oldest reassembly is evicted
+    hdr.index = 0;
+    for (unsigned int sender = 100; sender < 100 + CURSES_UI_FRAG_SLOTS; sender++)
+        CHECK(frag_add(t, sender, &hdr, "part", sender) == NULL);
+    unsigned long dropped = frag_dropped(t);
+    CHECK(frag_add(t, 999, &hdr, "part", 1000) == NULL);
+    CHECK(frag_dropped(t) == dropped + 1);
+    hdr.index = 1;
+    message = frag_add(t, 101, &hdr, "kept", 1001);
+    CHECK(message && strcmp(message, "partkept") == 0);
+    free(message);
+    CHECK(frag_add(t, 100, &hdr, "lost", 1001) == NULL);
+
+    // A forgotten sender's reassembly is dropped, so its id can start afresh
+    dropped = frag_dropped(t);
+    frag_forget(t, 102);
+    CHECK(frag_dropped(t) == dropped + 1);
+    CHECK(frag_add(t, 102, &hdr, "kept", 1002) == NULL);
+    frag_table_destroy(&t);
+}
+
+
+int main()
+{
+    test_header();
+    test_reassembly();
+    test_interleaved_senders();
+    test_drops();
+    return TEST_RESULT;
+}
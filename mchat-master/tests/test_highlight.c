@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <string.h>
+#include "curses_ui_highlight.h"
+#include "test.h"
+
+
+static int region_is(const char *text, const highlight_match_t *m, const char *expect)
+{
+    return m->len == strlen(expect) && strncmp(text + m->start, expect, m->len) == 0;
+}
+
+
+static void test_nick_and_words()
+{
+    highlighter_t *h = highlighter_create();
+    highlight_match_t m[CURSES_UI_MAX_HIGHLIGHTS];
+    CHECK(highlighter_scan(h, "nothing to see", m, CURSES_UI_MAX_HIGHLIGHTS) == 0);
+
+    CHECK(highlighter_set_nick(h, "bob") == 0);
+    CHECK(highlighter_add_word(h, "deploy") == 0);
+    CHECK(highlighter_add_word(h, "outage") == 0);
+    CHECK(highlighter_word_count(h) == 2);
+
+    const char *text = "Hey BOB, the Deploy caused an outage";
+    unsigned int count = highlighter_scan(h, text, m, CURSES_UI_MAX_HIGHLIGHTS);
+    CHECK(count == 3);
+    CHECK(count == 3 && region_is(text, &m[0], "BOB"));
+    CHECK(count == 3 && region_is(text, &m[1], "Deploy"));
+    CHECK(count == 3 && region_is(text, &m[2], "outage"));
+
+    // Changing the nickname recompiles the automaton on the next scan
+    CHECK(highlighter_set_nick(h, "alice") == 0);
+    CHECK(highlighter_scan(h, "bob and alice", m, CURSES_UI_MAX_HIGHLIGHTS) == 1);
+    highlighter_destroy(&h);
+    CHECK(h == NULL);
+}
+
+
+static void test_overlaps_merge()
+{
+    highlighter_t *h = highlighter_create();
+    highlight_match_t m[CURSES_UI_MAX_HIGHLIGHTS];
+    highlighter_add_word(h, "abc");
+    highlighter_add_word(h, "bcd");
+    highlighter_add_word(h, "cd");
+
+    const char *text = "xxabcdxx";
+    CHECK(highlighter_scan(h, text, m, CURSES_UI_MAX_HIGHLIGHTS) == 1);
+    CHECK(region_is(text, &m[0], "abcd"));
+
+    // Adjacent matches touch and are merged as well
+    text = "abcabc";
+    CHECK(highlighter_scan(h, text, m, CURSES_UI_MAX_HIGHLIGHTS) == 1);
+    CHECK(region_is(text, &m[0], "abcabc"));
+    highlighter_destroy(&h);
+}
+
+
+static void test_word_management()
+{
+    highlighter_t *h = highlighter_create();
+    highlight_match_t m[4];
+    CHECK(highlighter_add_word(h, "alpha") == 0);
+    CHECK(highlighter_add_word(h, "beta") == 0);
+    CHECK(highlighter_del_word(h, "alpha") == 0);
+    CHECK(highlighter_del_word(h, "gamma") != 0);
+    CHECK(highlighter_word_count(h) == 1);
+    CHECK(strcmp(highlighter_get_word(h, 0), "beta") == 0);
+    CHECK(highlighter_scan(h, "alpha beta", m, 4) == 1);
+
+    // Many words in one automaton, and at most max regions are returned
+    char word[16];
+    for (unsigned int i = 0; i < 500; i++)
+    {
+        snprintf(word, sizeof(word), "w%03u", i);
+        CHECK(highlighter_add_word(h, word) == 0);
+    }
+    CHECK(highlighter_scan(h, "w001 w250 w499 w500", m, 4) == 3);
+    CHECK(highlighter_scan(h, "w001 w002 w003 w004 w005 w006", m, 4) == 4);
+    CHECK(highlighter_memory(h) > 0);
+    highlighter_destroy(&h);
+}
+
+
+int main()
+{
+    test_nick_and_words();
+    test_overlaps_merge();
+    test_word_management();
+    return TEST_RESULT;
+}
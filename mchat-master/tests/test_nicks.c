@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <string.h>
+#include "curses_ui_nicks.h"
+#include "test.h"
+
+
+static void test_intern()
+{
+    nick_table_t *t = nick_table_create(CURSES_UI_MAX_NICKS, NULL, NULL);
+    unsigned long empty = nick_table_memory(t);
+    nick_entry_t *alice = nick_intern(t, "alice");
+    nick_entry_t *bob = nick_intern(t, "bob");
+    CHECK(alice && bob && alice != bob);
+    CHECK(alice->id == 0 && bob->id == 1);
+    CHECK(alice->len == 5 && strcmp(alice->name, "alice") == 0);
+
+    // The same nickname always comes back as the same entry
+    CHECK(nick_intern(t, "alice") == alice);
+    CHECK(nick_lookup_id(t, 1) == bob);
+    CHECK(nick_lookup_id(t, 2) == NULL);
+    CHECK(nick_table_count(t) == 2);
+
+    // Nicknames are case sensitive
+    CHECK(nick_intern(t, "Alice") != alice);
+    CHECK(nick_table_count(t) == 3);
+    CHECK(nick_table_memory(t) > empty);
+    nick_table_destroy(&t);
+    CHECK(t == NULL);
+}
+
+
+static void test_growth()
+{
+    nick_table_t *t = nick_table_create(CURSES_UI_MAX_NICKS, NULL, NULL);
+    char nick[32];
+    for (unsigned int i = 0; i < 5000; i++)
+    {
+        snprintf(nick, sizeof(nick), "peer%u", i);
+        nick_entry_t *e = nick_intern(t, nick);
+        CHECK(e && e->id == i);
+    }
+
+    // Entries keep their ids and addresses while the hash grows around them
+    nick_entry_t *first = nick_lookup_id(t, 0);
+    CHECK(first && strcmp(first->name, "peer0") == 0);
+    for (unsigned int i = 0; i < 5000; i += 499)
+    {
+        snprintf(nick, sizeof(nick), "peer%u", i);
+        nick_entry_t *e = nick_intern(t, nick);
+        CHECK(e && e->id == i && e == nick_lookup_id(t, i));
+    }
+    CHECK(nick_intern(t, "peer0") == first);
+    CHECK(nick_table_count(t) == 5000);
+    nick_table_destroy(&t);
+}
+
+
+static char evicted[64];
+
+static void evict(void *arg, nick_entry_t *e)
+{
+    (*(unsigned int *)arg)++;
+    snprintf(evicted, sizeof(evicted), "%s:%u", e->name, e->id);
+}
+
+
+// A full table makes room by dropping the nickname it has not seen for longest, and reuses its id
+static void test_evict()
+{
+    unsigned int evictions = 0;
+    CHECK(nick_table_create(0, NULL, NULL) == NULL);
+    CHECK(nick_table_create(CURSES_UI_MAX_NICKS + 1, NULL, NULL) == NULL);
+    nick_table_t *t = nick_table_create(3, evict, &evictions);
+    nick_entry_t *alice = nick_intern(t, "alice");
+    nick_intern(t, "bob");
+    nick_intern(t, "carol");
+    CHECK(nick_intern(t, "alice") == alice);
+    CHECK(evictions == 0);
+
+    nick_entry_t *dave = nick_intern(t, "dave");
+    CHECK(evictions == 1 && strcmp(evicted, "bob:1") == 0);
+    CHECK(dave && dave->id == 1 && nick_lookup_id(t, 1) == dave);
+    CHECK(nick_lookup(t, "bob") == NULL);
+    CHECK(nick_lookup(t, "alice") == alice && nick_lookup(t, "carol") != NULL);
+    CHECK(nick_table_count(t) == 3);
+
+    nick_intern(t, "bob");
+    CHECK(evictions == 2 && strcmp(evicted, "carol:2") == 0);
+    nick_table_destroy(&t);
+}
+
+
+// Interning never fails once the table is full, and every nickname left in it is still found
+static void test_churn()
+{
+    unsigned int evictions = 0;
+    nick_table_t *t = nick_table_create(100, evict, &evictions);
+    char nick[32];
+    for (unsigned int i = 0; i < 20000; i++)
+    {
+        snprintf(nick, sizeof(nick), "n%u", i % 7 == 0 ? i % 50 : i);
+        nick_entry_t *e = nick_intern(t, nick);
+        CHECK(e && e->id < 100 && nick_lookup_id(t, e->id) == e);
+    }
+    CHECK(nick_table_count(t) == 100);
+    CHECK(evictions > 0);
+    for (unsigned int id = 0; id < 100; id++)
+    {
+        nick_entry_t *e = nick_lookup_id(t, id);
+        CHECK(e && nick_lookup(t, e->name) == e);
+    }
+    nick_table_destroy(&t);
+}
+
+
+int main()
+{
+    test_intern();
+    test_growth();
+    test_evict();
+    test_churn();
+    return TEST_RESULT;
+}
@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <string.h>
+#include "curses_ui_reorder.h"
+#include "test.h"
+
+// Everything delivered, as "sender:body" joined by spaces
+static char delivered[4096];
+
+
+static void deliver(void *arg, unsigned int sender, const char *body)
+{
+    size_t len = strlen(delivered);
+    snprintf(delivered + len, sizeof(delivered) - len, "%s%u:%s", len ? " " : "", sender, body);
+}
+
+
+static int delivered_ends_with(const char *tail)
+{
+    size_t len = strlen(delivered), tail_len = strlen(tail);
+    return len >= tail_len && strcmp(delivered + len - tail_len, tail) == 0;
+}
+
+
+static void add_sent(reorder_t *r, unsigned int sender, unsigned int seq, long long sent_usec, long long now_ms)
+{
+    char body[32];
+    reorder_stamp_t stamp = { seq, sent_usec };
+    snprintf(body, sizeof(body), "%u", seq);
+    reorder_add(r, sender, &stamp, body, now_ms);
+}
+
+
+// Messages sent one after another, in the order they are added
+static void add(reorder_t *r, unsigned int sender, unsigned int seq, long long now_ms)
+{
+    static long long sent_usec = 1792354999000000LL;
+    add_sent(r, sender, seq, ++sent_usec, now_ms);
+}
+
+
+static void test_stamp()
+{
+    char buf[CURSES_UI_REORDER_STAMP_MAX + 8];
+    reorder_stamp_t stamp = { 0xfffffffe, 1792354999123456LL }, parsed;
+    int len = reorder_format_stamp(buf, &stamp);
+    CHECK(len > 0 && len < CURSES_UI_REORDER_STAMP_MAX);
+    strcpy(buf + len, "body");
+    const char *rest = reorder_parse(buf, &parsed);
+    CHECK(rest && strcmp(rest, "body") == 0);
+    CHECK(parsed.seq == stamp.seq && parsed.sent_usec == stamp.sent_usec);
+
+    CHECK(reorder_parse("plain", &parsed) == NULL);
+    CHECK(reorder_parse("\x1f" "S12.34", &parsed) == NULL);
+    CHECK(reorder_parse("\x1f" "F1.0.2\x1f" "x", &parsed) == NULL);
+}
+
+
+static void test_in_order()
+{
+    reorder_t *r = reorder_create(50, 8, deliver, NULL);
+    delivered[0] = '\0';
+    for (unsigned int seq = 10; seq < 14; seq++)
+        add(r, 1, seq, 0);
+    CHECK(strcmp(delivered, "1:10 1:11 1:12 1:13") == 0);
+    CHECK(reorder_held(r) == 0 && reorder_reordered(r) == 0 && reorder_late(r) == 0);
+    reorder_destroy(&r);
+    CHECK(r == NULL);
+}
+
+
+static void test_gap_filled()
+{
+    reorder_t *r = reorder_create(50, 8, deliver, NULL);
+    delivered[0] = '\0';
+    add(r, 1, 0, 0);
+    add(r, 1, 2, 0);
+    add(r, 1, 3, 0);
+    add(r, 2, 5, 0);
+    CHECK(strcmp(delivered, "1:0 2:5") == 0);
+    CHECK(reorder_held(r) == 2);
+    add(r, 1, 2, 0);	// duplicate of a held message
+    CHECK(reorder_held(r) == 2);
+    add(r, 1, 1, 10);
+    CHECK(strcmp(delivered, "1:0 2:5 1:1 1:2 1:3") == 0);
+    CHECK(reorder_held(r) == 0);
+    CHECK(reorder_reordered(r) == 2);
+    reorder_destroy(&r);
+}
+
+
+static void test_gap_expires()
+{
+    reorder_t *r = reorder_create(50, 8, deliver, NULL);
+    delivered[0] = '\0';
+    add(r, 1, 0, 0);
+    add(r, 1, 2, 100);
+    add(r, 1, 4, 120);
+    CHECK(reorder_expire(r, 120) == 30);
+    CHECK(reorder_expire(r, 150) == 20);
+    CHECK(strcmp(delivered, "1:0 1:2") == 0);
+    CHECK(reorder_expire(r, 170) == -1);
+    CHECK(strcmp(delivered, "1:0 1:2 1:4") == 0);
+
+    // The messages that were skipped over are late when they finally show up
+    add(r, 1, 1, 200);
+    add(r, 1, 3, 200);
+    CHECK(strcmp(delivered, "1:0 1:2 1:4 1:1 1:3") == 0);
+    CHECK(reorder_late(r) == 2);
+    reorder_destroy(&r);
+}
+
+
+static void test_full_buffer()
+{
+    reorder_t *r = reorder_create(50, 2, deliver, NULL);
+    delivered[0] = '\0';
+    add(r, 1, 0, 0);
+    add(r, 1, 2, 1);
+    add(r, 2, 0, 2);
+    add(r, 2, 2, 3);
+    CHECK(reorder_held(r) == 2);
+
+    // No room left, so the sender holding the oldest message gives up on its gap
+    add(r, 2, 4, 4);
+    CHECK(strcmp(delivered, "1:0 2:0 1:2") == 0);
+    CHECK(reorder_held(r) == 2);
+    reorder_flush(r);
+    CHECK(strcmp(delivered, "1:0 2:0 1:2 2:2 2:4") == 0);
+    CHECK(reorder_held(r) == 0);
+    reorder_destroy(&r);
+}
+
+
+// A sender that restarts its count is followed, not treated as a stream of late messages
+static void test_sender_restart()
+{
+    reorder_t *r = reorder_create(50, 4, deliver, NULL);
+    delivered[0] = '\0';
+    for (unsigned int seq = 100; seq < 110; seq++)
+        add(r, 1, seq, 0);
+    add(r, 1, 112, 0);
+    CHECK(reorder_held(r) == 1);
+    add(r, 1, 0, 0);
+    add(r, 1, 1, 0);
+    CHECK(delivered_ends_with("1:109 1:112 1:0 1:1"));
+    CHECK(reorder_late(r) == 0);
+    CHECK(reorder_held(r) == 0);
+
+    // Sequence numbers wrap without looking like a restart
+    add(r, 2, 0xffffffff, 0);
+    add(r, 2, 0, 0);
+    CHECK(delivered_ends_with(" 2:4294967295 2:0"));
+    CHECK(reorder_late(r) == 0);
+    CHECK(reorder_stale(r) == 0);
+    reorder_destroy(&r);
+}
+
+
+// Far behind but sent before the sender's newer messages is a straggler, not a restart
+static void test_stale_straggler()
+{
+    reorder_t *r = reorder_create(50, 4, deliver, NULL);
+    delivered[0] = '\0';
+    for (unsigned int seq = 100; seq < 110; seq++)
+        add_sent(r, 1, seq, 1000 + seq, 0);
+    add_sent(r, 1, 112, 1112, 0);
+    add_sent(r, 1, 3, 1003, 0);
+    CHECK(reorder_stale(r) == 1 && reorder_late(r) == 0);
+    CHECK(reorder_held(r) == 1);
+    CHECK(delivered_ends_with("1:109"));
+
+    // The sequence carries on as if the straggler had never arrived
+    add_sent(r, 1, 110, 1110, 0);
+    add_sent(r, 1, 111, 1111, 0);
+    CHECK(delivered_ends_with("1:109 1:110 1:111 1:112"));
+    CHECK(reorder_held(r) == 0);
+
+    // A send time equal to the newest one is not enough to count as a restart
+    add_sent(r, 1, 5, 1112, 0);
+    CHECK(reorder_stale(r) == 2);
+    add_sent(r, 1, 6, 1113, 0);
+    CHECK(delivered_ends_with("1:112 1:6"));
+    reorder_destroy(&r);
+}
+
+
+// A forgotten sender loses what was held for it, and its id starts a new sequence
+static void test_forget()
+{
+    reorder_t *r = reorder_create(50, 8, deliver, NULL);
+    delivered[0] = '\0';
+    add(r, 1, 10, 0);
+    add(r, 1, 12, 0);
+    add(r, 2, 0, 0);
+    add(r, 2, 2, 0);
+    CHECK(reorder_held(r) == 2);
+    reorder_forget(r, 1);
+    CHECK(reorder_held(r) == 1);
+    add(r, 1, 0, 0);
+    CHECK(strcmp(delivered, "1:10 2:0 1:0") == 0);
+    CHECK(reorder_late(r) == 0);
+    reorder_forget(r, 500);
+    reorder_destroy(&r);
+}
+
+
+static void test_configure()
+{
+    reorder_t *r = reorder_create(50, 8, deliver, NULL);
+    delivered[0] = '\0';
+    add(r, 1, 0, 0);
+    add(r, 1, 5, 0);
+    CHECK(reorder_configure(r, 10, 0) != 0);
+    CHECK(reorder_configure(r, 10, CURSES_UI_REORDER_MAX_SIZE + 1) != 0);
+    CHECK(reorder_configure(r, 10, 16) == 0);
+    CHECK(strcmp(delivered, "1:0 1:5") == 0);
+    CHECK(reorder_hold_ms(r) == 10 && reorder_size(r) == 16 && reorder_held(r) == 0);
+    CHECK(reorder_memory(r) > 0);
+    reorder_destroy(&r);
+}
+
+
+int main()
+{
+    test_stamp();
+    test_in_order();
+    test_gap_filled();
+    test_gap_expires();
+    test_full_buffer();
+    test_sender_restart();
+    test_stale_straggler();
+    test_forget();
+    test_configure();
+    return TEST_RESULT;
+}
@@ -0,0 +1,212 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include "curses_ui_sock.h"
+#include "test.h"
+
+
+// Connected, non-blocking pair of connections
+static int conn_pair(sock_conn_t **a, sock_conn_t **b)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return -1;
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    *a = sock_conn_create(fds[0]);
+    *b = sock_conn_create(fds[1]);
+    return 0;
+}
+
+
+static void test_framing()
+{
+    sock_conn_t *a, *b;
+    CHECK(conn_pair(&a, &b) == 0);
+    char *fields[CURSES_UI_SOCK_MAX_FIELDS];
+
+    CHECK(sock_conn_queue(a, "MSG", "bob", "tab\there, newline\nthere, back\\slash", NULL) == 0);
+    CHECK(sock_conn_queue(a, "PEERS_END", NULL) == 0);
+    CHECK(sock_conn_queue(a, "EMPTY", "", NULL) == 0);
+    CHECK(sock_conn_flush(a) == 0);
+    CHECK(a->out_len == 0);
+    CHECK(sock_conn_read(b) > 0);
+
+    CHECK(sock_conn_next_frame(b, fields, CURSES_UI_SOCK_MAX_FIELDS) == 3);
+    CHECK(strcmp(fields[0], "MSG") == 0 && strcmp(fields[1], "bob") == 0);
+    CHECK(strcmp(fields[2], "tab\there, newline\nthere, back\\slash") == 0);
+    CHECK(sock_conn_next_frame(b, fields, CURSES_UI_SOCK_MAX_FIELDS) == 1);
+    CHECK(strcmp(fields[0], "PEERS_END") == 0);
+    CHECK(sock_conn_next_frame(b, fields, CURSES_UI_SOCK_MAX_FIELDS) == 2);
+    CHECK(strcmp(fields[0], "EMPTY") == 0 && fields[1][0] == '\0');
+    CHECK(sock_conn_next_frame(b, fields, CURSES_UI_SOCK_MAX_FIELDS) == 0);
+
+    // Nothing to read is not an error, extra fields stay in the last one
+    CHECK(sock_conn_read(b) == 0);
+    CHECK(write(a->fd, "A\tB\tC\n", 6) == 6);
+    CHECK(sock_conn_read(b) == 6);
+    CHECK(sock_conn_next_frame(b, fields, 2) == 2);
+    CHECK(strcmp(fields[1], "B\tC") == 0);
+
+    // A frame split across reads is only returned once it is complete
+    CHECK(write(a->fd, "PART", 4) == 4);
+    CHECK(sock_conn_read(b) == 4);
+    CHECK(sock_conn_next_frame(b, fields, CURSES_UI_SOCK_MAX_FIELDS) == 0);
+    CHECK(write(a->fd, "IAL\n", 4) == 4);
+    CHECK(sock_conn_read(b) == 4);
+    CHECK(sock_conn_next_frame(b, fields, CURSES_UI_SOCK_MAX_FIELDS) == 1);
+    CHECK(strcmp(fields[0], "PARTIAL") == 0);
+
+    // The peer going away
+    sock_conn_destroy(&a);
+    CHECK(a == NULL);
+    CHECK(sock_conn_read(b) == -1);
+    sock_conn_destroy(&b);
+}
+
+
+// Buffers grow with a burst of traffic, shrink once drained, and a full buffer is not a lost peer
+static void test_buffers()
+{
+    sock_conn_t *a, *b;
+    CHECK(conn_pair(&a, &b) == 0);
+    char *fields[CURSES_UI_SOCK_MAX_FIELDS];
+    char body[1000];
+    memset(body, 'x', sizeof(body) - 1);
+    body[sizeof(body) - 1] = '\0';
+    unsigned long idle = sock_conn_memory(b);
+
+    unsigned int sent = 0, received = 0;
+    while (received < 6000)
+    {
+        while (sent < 6000 && a->out_len < 64 * 1024)
+        {
+            CHECK(sock_conn_queue(a, "MSG", body, NULL) == 0);
+            sent++;
+        }
+        CHECK(sock_conn_flush(a) == 0);
+        int got;
+        while ((got = sock_conn_read(b)) > 0)
+            ;
+        CHECK(got == 0);
+        while (sock_conn_next_frame(b, fields, CURSES_UI_SOCK_MAX_FIELDS) == 2)
+            received++;
+    }
+    CHECK(!a->overflow);
+    CHECK(a->out_len == 0 && b->in_len == 0);
+    CHECK(sock_conn_memory(a) <= idle + 4096);
+    CHECK(sock_conn_memory(b) <= idle + 4096);
+
+    // Fill the input buffer with complete frames without parsing any of them
+    char *big = malloc(CURSES_UI_SOCK_MAX_BUFFER);
+    if (big)
+    {
+        memset(big, 'y', CURSES_UI_SOCK_MAX_BUFFER);
+        for (size_t i = 1023; i < CURSES_UI_SOCK_MAX_BUFFER; i += 1024)
+            big[i] = '\n';
+        size_t off = 0;
+        int full = 0;
+        while (!full)
+        {
+            ssize_t w = off < CURSES_UI_SOCK_MAX_BUFFER ? write(a->fd, big + off, CURSES_UI_SOCK_MAX_BUFFER - off) : 0;
+            if (w > 0)
+                off += w;
+            int got = sock_conn_read(b);
+            CHECK(got >= 0);
+            full = got <= 0 && b->in_len == CURSES_UI_SOCK_MAX_BUFFER;
+            if (got < 0)
+                break;
+        }
+        CHECK(sock_conn_read(b) == 0);
+        CHECK(sock_conn_next_frame(b, fields, CURSES_UI_SOCK_MAX_FIELDS) == 1);
+        free(big);
+    }
+    sock_conn_destroy(&a);
+    sock_conn_destroy(&b);
+}
+
+
+static void test_listen(const char *dir)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/sock", dir);
+
+    int fd = sock_listen_unix(path, 0600);
+    CHECK(fd >= 0);
+
+    // Somebody is listening, so the path is not taken over
+    errno = 0;
+    CHECK(sock_listen_unix(path, 0600) == -1 && errno == EADDRINUSE);
+
+    int client = sock_connect_unix(path);
+    CHECK(client >= 0);
+    int server = -1;
+    for (int i = 0; i < 100 && server < 0; i++)
+    {
+        server = sock_accept(fd);
+        if (server < 0)
+            usleep(1000);
+    }
+    CHECK(server >= 0);
+    close(server);
+    close(client);
+
+    // A socket nobody listens on any more is stale and gets replaced
+    close(fd);
+    fd = sock_listen_unix(path, 0600);
+    CHECK(fd >= 0);
+    close(fd);
+    unlink(path);
+
+    // The socket gets exactly the mode asked for, whatever the umask
+    mode_t umask_old = umask(0077);
+    struct stat st;
+    fd = sock_listen_unix(path, 0666);
+    CHECK(fd >= 0 && stat(path, &st) == 0 && (st.st_mode & 0777) == 0666);
+    close(fd);
+    umask(0);
+    fd = sock_listen_unix(path, 0600);
+    CHECK(fd >= 0 && stat(path, &st) == 0 && (st.st_mode & 0777) == 0600);
+    close(fd);
+    umask(umask_old);
+    unlink(path);
+
+    // Anything that is not a socket is left alone
+    snprintf(path, sizeof(path), "%s/file", dir);
+    FILE *fp = fopen(path, "w");
+    if (fp)
+    {
+        fputs("keep me\n", fp);
+        fclose(fp);
+    }
+    errno = 0;
+    CHECK(sock_listen_unix(path, 0600) == -1 && errno == EEXIST);
+    CHECK(access(path, F_OK) == 0);
+    unlink(path);
+
+    errno = 0;
+    snprintf(path, sizeof(path), "%s/missing", dir);
+    CHECK(sock_connect_unix(path) == -1);
+}
+
+
+int main()
+{
+    char dir[] = "/tmp/curses_ui_test_sock_XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    test_framing();
+    test_buffers();
+    test_listen(dir);
+    rmdir(dir);
+    return TEST_RESULT;
+}
@@ -0,0 +1,69 @@
+#include "curses_ui_stats.h"
+#include "test.h"
+
+
+static int near(double a, double b)
+{
+    double diff = a > b ? a - b : b - a;
+    return diff < 1e-6 * (b > 0 ? b + 1 : 1 - b);
+}
+
+
+static void test_rate()
+{
+    peer_stats_t st = { 0 };
+    CHECK(peer_stats_rate(&st) == 0);
+    peer_stats_update(&st, 1000000, -1);
+    CHECK(st.count == 1 && peer_stats_rate(&st) == 0);
+
+    // A steady 100ms between messages is 10 per second
+    for (long long t = 1100000; t <= 2000000; t += 100000)
+        peer_stats_update(&st, t, -1);
+    CHECK(st.count == 11);
+    CHECK(near(st.interval_usec, 100000));
+    CHECK(near(peer_stats_rate(&st), 10));
+    CHECK(st.stamped == 0 && st.skew_usec == 0 && st.jitter_usec == 0);
+
+    // A clock step backwards counts as no time passing rather than a negative interval
+    peer_stats_update(&st, 1000000, -1);
+    CHECK(st.interval_usec < 100000 && st.interval_usec > 0);
+}
+
+
+static void test_skew_and_jitter()
+{
+    peer_stats_t st = { 0 };
+
+    // The sender's clock is 2s behind ours
+    peer_stats_update(&st, 10000000, 8000000);
+    CHECK(st.stamped == 1);
+    CHECK(near(st.skew_usec, 2000000));
+    CHECK(st.jitter_usec == 0);
+
+    // Constant transit time: no jitter, and the skew stays put
+    peer_stats_update(&st, 11000000, 9000000);
+    CHECK(near(st.skew_usec, 2000000) && st.jitter_usec == 0);
+
+    // Transit alternating by 16ms settles towards 16ms of jitter, averaged at 1/16 per message
+    for (int i = 0; i < 200; i++)
+    {
+        long long recv = 12000000 + i * 1000000LL;
+        peer_stats_update(&st, recv, recv - 2000000 - (i % 2 ? 16000 : 0));
+    }
+    CHECK(st.jitter_usec > 15000 && st.jitter_usec < 16000);
+    CHECK(st.skew_usec > 2000000 && st.skew_usec < 2016000);
+
+    // Unstamped messages count towards the rate only
+    unsigned long stamped = st.stamped;
+    double skew = st.skew_usec;
+    peer_stats_update(&st, 300000000, -1);
+    CHECK(st.stamped == stamped && st.skew_usec == skew);
+}
+
+
+int main()
+{
+    test_rate();
+    test_skew_and_jitter();
+    return TEST_RESULT;
+}
@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include "curses_ui_timer.h"
+#include "test.h"
+
+typedef struct fired {
+    unsigned int count;
+    long long last_ms;
+    int ret;			// returned to the wheel, non-zero cancels a periodic timer
+} fired_t;
+
+static long long now_ms;
+
+
+static int record(struct ui_state *s, void *arg)
+{
+    fired_t *f = arg;
+    f->count++;
+    f->last_ms = now_ms;
+    return f->ret;
+}
+
+
+// Step the clock a millisecond at a time, as the main loop would with a busy terminal
+static void run_until(timer_wheel_t *w, long long until_ms)
+{
+    while (now_ms < until_ms)
+    {
+        now_ms++;
+        timer_wheel_run(w, now_ms);
+    }
+}
+
+
+static void test_one_shot()
+{
+    now_ms = 1000;
+    timer_wheel_t *w = timer_wheel_create(NULL, now_ms);
+    fired_t f = { 0, 0, 0 };
+    timer_add(w, 50, 0, record, &f);
+    CHECK(timer_wheel_count(w) == 1);
+    CHECK(timer_wheel_memory(w) > 0);
+
+    run_until(w, 1049);
+    CHECK(f.count == 0);
+    run_until(w, 1050 + CURSES_UI_TIMER_TICK_MS);
+    CHECK(f.count == 1);
+    CHECK(f.last_ms >= 1050);
+    CHECK(timer_wheel_count(w) == 0);
+
+    run_until(w, 2000);
+    CHECK(f.count == 1);
+    timer_wheel_destroy(&w);
+    CHECK(w == NULL);
+}
+
+
+static void test_periodic()
+{
+    now_ms = 0;
+    timer_wheel_t *w = timer_wheel_create(NULL, now_ms);
+    fired_t f = { 0, 0, 0 };
+    timer_add(w, 100, 100, record, &f);
+    run_until(w, 1005);
+    CHECK(f.count == 10);
+
+    // A non-zero return cancels the timer
+    f.ret = 1;
+    run_until(w, 1200);
+    CHECK(f.count == 11);
+    CHECK(timer_wheel_count(w) == 0);
+    timer_wheel_destroy(&w);
+}
+
+
+static void test_cancel()
+{
+    now_ms = 0;
+    timer_wheel_t *w = timer_wheel_create(NULL, now_ms);
+    fired_t a = { 0, 0, 0 }, b = { 0, 0, 0 };
+    ui_timer_t *ta = timer_add(w, 30, 0, record, &a);
+    timer_add(w, 30, 0, record, &b);
+    timer_cancel(w, ta);
+    run_until(w, 100);
+    CHECK(a.count == 0);
+    CHECK(b.count == 1);
+    timer_wheel_destroy(&w);
+}
+
+
+// Delays past the bottom wheel are cascaded down and must still fire on time
+static void test_cascade()
+{
+    static const unsigned int delays[] = { 700, 5000, 45000, 3000000 };
+    now_ms = 0;
+    timer_wheel_t *w = timer_wheel_create(NULL, now_ms);
+    fired_t f[4];
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        f[i].count = 0;
+        f[i].ret = 0;
+        timer_add(w, delays[i], 0, record, &f[i]);
+    }
+    run_until(w, 3000000 + CURSES_UI_TIMER_TICK_MS);
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        CHECK(f[i].count == 1);
+        CHECK(f[i].last_ms >= delays[i]);
+        CHECK(f[i].last_ms <= delays[i] + CURSES_UI_TIMER_TICK_MS);
+    }
+    timer_wheel_destroy(&w);
+}
+
+
+static void test_next_timeout()
+{
+    now_ms = 0;
+    timer_wheel_t *w = timer_wheel_create(NULL, now_ms);
+    CHECK(timer_wheel_next_timeout(w, now_ms, 250) == 250);
+
+    fired_t f = { 0, 0, 0 };
+    timer_add(w, 40, 0, record, &f);
+    int wait = timer_wheel_next_timeout(w, now_ms, 250);
+    CHECK(wait > 0 && wait <= 40);
+    run_until(w, 60);
+    CHECK(timer_wheel_next_timeout(w, now_ms, 250) <= 250);
+    timer_wheel_destroy(&w);
+}
+
+
+int main()
+{
+    test_one_shot();
+    test_periodic();
+    test_cancel();
+    test_cascade();
+    test_next_timeout();
+    return TEST_RESULT;
+}